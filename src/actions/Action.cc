@@ -64,4 +64,9 @@ Action::Action(ActionId id, const char *shortName, const char *fullName,
       onExcellent(false),
       onPoor(false),
       isCombo(true),
-      comboActions(comboActions) {}
\ No newline at end of file
+      comboActions(comboActions) {}
+
+bool Action::isUsable(Condition condition) const {
+    return (onExcellent && condition == Excellent) || (onGood && condition == Good) ||
+           (onPoor && condition == Poor) || (!onExcellent && !onGood && !onPoor);
+}
\ No newline at end of file
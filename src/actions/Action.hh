@@ -4,6 +4,7 @@
 #include <initializer_list>
 #include <vector>
 
+#include "../model/Condition.hh"
 #include "ActionId.hh"
 #include "ActionType.hh"
 
@@ -23,6 +24,9 @@ struct Action {
            double progressIncreaseMultiplier, ActionType type, int activeTurns, int level,
            std::initializer_list<ActionId> comboActions);
 
+    // Whether the action can be used under this material condition.
+    bool isUsable(Condition condition) const;
+
     const ActionId              id;
     const char                 *shortName;
     const char                 *fullName;
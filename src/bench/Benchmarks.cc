@@ -0,0 +1,588 @@
+// Microbenchmarks of the simulator and of the genetic engine's hot paths.
+//
+// Every benchmark runs over a fixed corpus of crafts and fixed-seed sequences,
+// so that numbers from two builds can be compared. Results are printed as CSV,
+// one line per benchmark, craft and thread count. Allocation budgets given on
+// the command line are checked against every line, for the exit status.
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../actions/ActionTable.hh"
+#include "../config/JobFile.hh"
+#include "../model/ConditionModel.hh"
+#include "../model/State.hh"
+#include "../model/Synth.hh"
+#include "../solver/Solver.hh"
+#include "../solver/SolverSettings.hh"
+#include "../solver/montecarlo/MonteCarloSim.hh"
+#include "../solver/parallel/ThreadPool.hh"
+#include "../solver/profile/Allocations.hh"
+#include "../solver/profile/PerfCounters.hh"
+#include "../solver/simulation/SimSynth.hh"
+
+// Builds tracking allocations count them in the core library already.
+#ifndef FFXIVCRAFTING_TRACK_ALLOCATIONS
+
+namespace {
+
+// Heap allocations made by the whole process so far.
+std::atomic<long> allocationCount{0};
+
+long allocations() { return allocationCount.load(); }
+
+}  // namespace
+
+// The array and nothrow forms call these.
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc() wants a non-zero multiple of the alignment.
+    size_t align = static_cast<size_t>(alignment);
+    size = size > 0 ? (size + align - 1) / align * align : align;
+    if (void* p = std::aligned_alloc(align, size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC sees free() called on what operator new returned, not knowing that this
+// operator new is the one above.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+namespace {
+
+long allocations() { return Allocations::total().count; }
+
+}  // namespace
+
+#endif
+
+namespace {
+
+constexpr unsigned SEED = 20240501;
+
+// Random sequences per craft, on top of its known macro.
+constexpr int RANDOM_SEQUENCES = 255;
+
+constexpr const char* CRAFTER = R"({
+    "class": "CUL", "level": 90, "craftsmanship": 4041, "control": 4043,
+    "craftingPoints": 611,
+    "actions": ["muscleMemory", "reflect", "trainedEye", "basicSynth2",
+                "carefulSynthesis2", "groundwork2", "prudentSynthesis",
+                "delicateSynthesis", "focusedSynthesisCombo", "focusedTouchCombo",
+                "standardTouchCombo", "advancedTouchCombo", "basicTouch",
+                "standardTouch", "advancedTouch", "byregotsBlessing", "prudentTouch",
+                "preparatoryTouch", "trainedFinesse", "mastersMend", "wasteNot",
+                "wasteNot2", "manipulation", "veneration", "greatStrides",
+                "innovation", "observe"]
+})";
+
+constexpr const char* BAKED_EGGPLANT = R"({
+    "baseLevel": 90, "level": 640, "difficulty": 6600, "durability": 70,
+    "maxQuality": 14040, "suggestedCraftsmanship": 3700, "suggestedControl": 3280,
+    "progressDivider": 130, "progressModifier": 80, "qualityDivider": 115,
+    "qualityModifier": 70, "stars": 4
+})";
+
+constexpr const char* SYKON_BAVAROIS = R"({
+    "baseLevel": 90, "level": 560, "difficulty": 3500, "durability": 80,
+    "maxQuality": 7200, "suggestedCraftsmanship": 2805, "suggestedControl": 2635,
+    "progressDivider": 130, "progressModifier": 90, "qualityDivider": 115,
+    "qualityModifier": 80
+})";
+
+constexpr const char* MACRO = R"([
+    "muscleMemory", "veneration", "groundwork2", "prudentSynthesis",
+    "carefulSynthesis2", "groundwork2", "mastersMend", "advancedTouchCombo",
+    "mastersMend", "carefulSynthesis2", "manipulation", "standardTouchCombo",
+    "focusedTouchCombo", "innovation", "standardTouch", "advancedTouch",
+    "greatStrides", "byregotsBlessing", "carefulSynthesis2"
+])";
+
+// The crafts benchmarked: a high and a mid level recipe, and the high level one
+// with conditions, which takes the slower paths of the simulators.
+std::vector<BatchJob> corpus() {
+    auto job = [](const char* name, const char* recipe, bool useConditions) {
+        return std::string("{\"name\": \"") + name + "\", \"recipe\": " + recipe +
+               ", \"crafter\": " + CRAFTER + ", \"sequence\": " + MACRO +
+               ", \"useConditions\": " + (useConditions ? "true" : "false") +
+               ", \"quiet\": true, \"solver\": {\"population\": 2000, "
+               "\"subPopulations\": 10}}";
+    };
+    std::string text = "[" + job("eggplant", BAKED_EGGPLANT, false) + "," +
+                       job("bavarois", SYKON_BAVAROIS, false) + "," +
+                       job("eggplant-conditions", BAKED_EGGPLANT, true) + "]";
+    return parseJobs(text, "corpus", nullptr);
+}
+
+// Steps a sequence takes in the game, with combos counting as their parts.
+int steps(const ActionSequence& sequence) {
+    int n = 0;
+    for (ActionId actionId : sequence) {
+        const Action& action = ALL_ACTIONS[actionId];
+        n += action.isCombo ? action.comboActions.size() : 1;
+    }
+    return n;
+}
+
+struct Measurement {
+    long          calls = 0;
+    long          steps = 0;
+    long          allocations = 0;
+    double        seconds = 0;
+    // Of the calling thread only. All zero if there are no hardware counters.
+    CounterValues counters{};
+};
+
+double seconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since)
+        .count();
+}
+
+void printHeader() {
+    printf(
+        "benchmark,craft,threads,calls,seconds,ns_per_call,ns_per_step,"
+        "calls_per_second,allocs_per_call,ipc,llc_miss_percent,branch_miss_percent\n");
+}
+
+// Blank columns for what doesn't apply.
+void printMeasurement(const char* benchmark, const std::string& craft, int threads,
+                      const Measurement& m) {
+    printf("%s,%s,%d,%ld,%.4f,%.1f,", benchmark, craft.c_str(), threads, m.calls,
+           m.seconds, 1e9 * m.seconds / m.calls);
+    if (m.steps > 0) {
+        printf("%.2f", 1e9 * m.seconds / m.steps);
+    }
+    printf(",%.1f,", m.calls / m.seconds);
+    if (m.allocations >= 0) {
+        printf("%.2f", static_cast<double>(m.allocations) / m.calls);
+    }
+    for (double rate : {PerfCounters::ipc(m.counters),
+                        PerfCounters::cacheMissPercent(m.counters),
+                        PerfCounters::branchMissPercent(m.counters)}) {
+        printf(",");
+        if (rate >= 0) {
+            printf("%.3f", rate);
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+}  // namespace
+
+// A friend of State and Solver, for timing their private hot paths directly.
+class Benchmarks {
+   public:
+    // budgets holds the most allocations per call allowed, by benchmark name.
+    Benchmarks(double minSeconds, int maxThreads, std::string filter,
+               std::map<std::string, double> budgets)
+        : _minSeconds(minSeconds),
+          _pool(maxThreads),
+          _filter(std::move(filter)),
+          _budgets(std::move(budgets)),
+          _overBudget(0) {}
+
+    // Returns how many measurements went over their allocation budget.
+    int run() {
+        std::string reason = PerfCounters::unavailableReason();
+        if (!reason.empty()) {
+            fprintf(stderr, "Hardware counters unavailable (%s), leaving them blank.\n",
+                    reason.c_str());
+        }
+
+        printHeader();
+        for (BatchJob& job : corpus()) {
+            Craft craft(job);
+            if (selected("applyModifiers")) {
+                applyModifiers(craft);
+            }
+            if (selected("MonteCarloSim::step")) {
+                monteCarloStep(craft);
+            }
+            if (selected("SimSynth::execute")) {
+                simSynthExecute(craft);
+            }
+            if (selected("Solver::evalSeq")) {
+                evalSeq(craft);
+            }
+            if (selected("Solver::runOneGen")) {
+                runOneGen(craft);
+            }
+            if (selected("scaling:SimSynth::execute")) {
+                executeScaling(craft);
+            }
+            if (selected("scaling:Solver::runOneGen")) {
+                runOneGenScaling(craft);
+            }
+        }
+        return _overBudget;
+    }
+
+   private:
+    // A craft of the corpus and what its benchmarks run on.
+    struct Craft {
+        explicit Craft(BatchJob& job)
+            : name(job.name),
+              settings(job.settings),
+              synth(settings.crafter, settings.recipe, settings.maxTrickUses,
+                    settings.reliabilityPercent / 100.0, settings.useConditions,
+                    settings.maxLength, settings.solver),
+              startState(synth) {
+            // The known macro, then random sequences as the genetic engine makes
+            // them.
+            sequences.push_back(settings.sequence);
+            Solver solver(settings);
+            solver._rng.seed(SEED);
+            for (int i = 0; i < RANDOM_SEQUENCES; ++i) {
+                sequences.push_back(solver.randomActionSequence());
+            }
+
+            // The state before every single action of every sequence, combos
+            // taken apart, for the benchmarks of one step.
+            SimSynth simSynth;
+            for (const ActionSequence& sequence : sequences) {
+                State s(startState);
+                for (ActionId actionId : sequence) {
+                    const Action& action = ALL_ACTIONS[actionId];
+                    if (action.isCombo) {
+                        for (ActionId part : action.comboActions) {
+                            stepStates.push_back(s);
+                            stepActions.push_back(part);
+                            simSynth.step(s, part, false);
+                        }
+                    } else {
+                        stepStates.push_back(s);
+                        stepActions.push_back(actionId);
+                        simSynth.step(s, actionId, false);
+                    }
+                }
+            }
+        }
+
+        std::string    name;
+        SolverSettings settings;
+        Synth          synth;
+        State          startState;
+
+        std::vector<ActionSequence> sequences;
+        std::vector<State>          stepStates;
+        std::vector<ActionId>       stepActions;
+    };
+
+    void report(const char* benchmark, const std::string& craft, int threads,
+                const Measurement& m) {
+        printMeasurement(benchmark, craft, threads, m);
+
+        auto budget = _budgets.find(benchmark);
+        if (budget == _budgets.end() || m.allocations < 0) {
+            return;
+        }
+        double perCall = static_cast<double>(m.allocations) / m.calls;
+        if (perCall > budget->second) {
+            fprintf(stderr,
+                    "%s on %s: %.2f allocations per call, over the budget of %g\n",
+                    benchmark, craft.c_str(), perCall, budget->second);
+            ++_overBudget;
+        }
+    }
+
+    bool selected(const char* benchmark) const {
+        return _filter.empty() || strstr(benchmark, _filter.c_str()) != nullptr;
+    }
+
+    // Calls pass() until minSeconds have passed. A pass returns how many calls
+    // and steps it made.
+    Measurement measure(const std::function<std::pair<long, long>()>& pass) const {
+        // One pass to warm up caches and lazily built tables.
+        pass();
+
+        Measurement   m;
+        CounterValues countersBefore;
+        bool          counted = PerfCounters::read(countersBefore);
+        long          allocationsBefore = allocations();
+        auto          start = std::chrono::steady_clock::now();
+        do {
+            auto [calls, steps] = pass();
+            m.calls += calls;
+            m.steps += steps;
+        } while (seconds(start) < _minSeconds);
+        m.seconds = seconds(start);
+        m.allocations = allocations() - allocationsBefore;
+        if (counted && PerfCounters::read(m.counters)) {
+            for (int i = 0; i < COUNTER_COUNT; ++i) {
+                m.counters[i] -= countersBefore[i];
+            }
+        }
+        return m;
+    }
+
+    void applyModifiers(const Craft& craft) {
+        const ConditionModel condition{.checkGoodOrExcellent = []() { return true; },
+                                       .pGoodOrExcellent = []() { return 1.0; }};
+
+        // applyModifiers() updates combo and waste counters, so every call gets
+        // a fresh copy of its state.
+        double sink = 0;
+        auto   pass = [&]() {
+            for (int i = 0; i < craft.stepStates.size(); ++i) {
+                State         s(craft.stepStates[i]);
+                ModifiedState r =
+                    s.applyModifiers(ALL_ACTIONS[craft.stepActions[i]], condition);
+                sink += r.bProgressGain + r.bQualityGain;
+            }
+            long n = craft.stepStates.size();
+            return std::pair{n, n};
+        };
+        report("applyModifiers", craft.name, 1, measure(pass));
+        keep(sink);
+    }
+
+    void monteCarloStep(const Craft& craft) {
+        MonteCarloSim monteCarloSim;
+        monteCarloSim.seed(SEED);
+
+        double sink = 0;
+        auto   pass = [&]() {
+            for (int i = 0; i < craft.stepStates.size(); ++i) {
+                State s = monteCarloSim.step(craft.stepStates[i],
+                                             ALL_ACTIONS[craft.stepActions[i]], false,
+                                             false, false);
+                sink += s.quality();
+            }
+            long n = craft.stepStates.size();
+            return std::pair{n, n};
+        };
+        report("MonteCarloSim::step", craft.name, 1, measure(pass));
+        keep(sink);
+    }
+
+    void simSynthExecute(const Craft& craft) {
+        SimSynth simSynth;
+
+        double sink = 0;
+        auto   pass = [&]() {
+            long n = 0;
+            for (const ActionSequence& sequence : craft.sequences) {
+                State s =
+                    simSynth.execute(sequence, craft.startState, false, false, false);
+                sink += s.quality();
+                n += steps(sequence);
+            }
+            return std::pair<long, long>{craft.sequences.size(), n};
+        };
+        report("SimSynth::execute", craft.name, 1, measure(pass));
+        keep(sink);
+    }
+
+    void evalSeq(const Craft& craft) {
+        SolverSettings settings(craft.settings);
+        Solver         solver(settings, _pool);
+
+        double sink = 0;
+        auto   pass = [&]() {
+            long n = 0;
+            for (const ActionSequence& sequence : craft.sequences) {
+                Fitness fitness =
+                    solver.evalSeq(sequence, craft.synth, settings.solver.penaltyWeight);
+                sink += fitness.fitness;
+                n += steps(sequence);
+            }
+            return std::pair<long, long>{craft.sequences.size(), n};
+        };
+        report("Solver::evalSeq", craft.name, 1, measure(pass));
+        keep(sink);
+    }
+
+    void runOneGen(const Craft& craft) {
+        SolverSettings settings(craft.settings);
+        Solver         solver(settings, _pool);
+        startPopulation(solver, craft);
+
+        auto pass = [&]() {
+            solver.runOneGen(craft.synth);
+            return std::pair<long, long>{1, 0};
+        };
+        report("Solver::runOneGen", craft.name, 1, measure(pass));
+    }
+
+    // Sequences per second with the sequences spread over more and more threads.
+    void executeScaling(const Craft& craft) {
+        for (int threads : threadCounts()) {
+            auto pass = [&]() {
+                // Each thread takes whole sequences, and simulates them 16 times
+                // so that handing them out doesn't dominate.
+                _pool.parallelFor(craft.sequences.size(), threads, [&](int i) {
+                    SimSynth simSynth;
+                    for (int k = 0; k < 16; ++k) {
+                        simSynth.execute(craft.sequences[i], craft.startState, false,
+                                         false, false);
+                    }
+                });
+                return std::pair<long, long>{16 * craft.sequences.size(), 0};
+            };
+            Measurement m = measure(pass);
+            m.allocations = -1;
+            report("scaling:SimSynth::execute", craft.name, threads, m);
+        }
+    }
+
+    // Generations per second of as many independent solvers as threads.
+    void runOneGenScaling(const Craft& craft) {
+        for (int threads : threadCounts()) {
+            std::vector<SolverSettings> settings(threads, craft.settings);
+            std::vector<std::unique_ptr<Solver>> solvers;
+            for (int i = 0; i < threads; ++i) {
+                solvers.push_back(std::make_unique<Solver>(settings[i], _pool));
+                startPopulation(*solvers.back(), craft);
+            }
+
+            auto pass = [&]() {
+                _pool.parallelFor(threads, threads,
+                                  [&](int i) { solvers[i]->runOneGen(craft.synth); });
+                return std::pair<long, long>{threads, 0};
+            };
+            Measurement m = measure(pass);
+            m.allocations = -1;
+            report("scaling:Solver::runOneGen", craft.name, threads, m);
+        }
+    }
+
+    // The population solve() starts the genetic engine with, from a fixed seed.
+    static void startPopulation(Solver& solver, const Craft& craft) {
+        solver._rng.seed(SEED);
+        solver.resetOperators();
+        solver.initializePopulation(craft.synth, craft.settings.sequence);
+    }
+
+    // 1, 2, 4, ... up to the size of the pool, and the size of the pool.
+    std::vector<int> threadCounts() const {
+        std::vector<int> counts;
+        for (int threads = 1; threads < _pool.size(); threads *= 2) {
+            counts.push_back(threads);
+        }
+        counts.push_back(_pool.size());
+        return counts;
+    }
+
+    // Keeps the compiler from dropping work whose result is never used.
+    static void keep(double x) { asm volatile("" : : "g"(x)); }
+
+    double                        _minSeconds;
+    ThreadPool                    _pool;
+    std::string                   _filter;
+    std::map<std::string, double> _budgets;
+    int                           _overBudget;
+};
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--min-time SECONDS] [--threads N] [--filter NAME]\n"
+            "          [--alloc-budget NAME=N]...\n"
+            "\n"
+            "Times the simulator and the genetic engine over a fixed corpus and\n"
+            "prints the results as CSV. Exits with 1 if a benchmark allocates more\n"
+            "than its budget.\n"
+            "\n"
+            "  --min-time SECONDS\n"
+            "               least time spent on each benchmark, 0.5 by default\n"
+            "  --threads N  most threads for the scaling benchmarks, 0 for one per\n"
+            "               hardware thread\n"
+            "  --filter NAME\n"
+            "               only runs the benchmarks whose name contains NAME\n"
+            "  --alloc-budget NAME=N\n"
+            "               most allocations per call the benchmark NAME may make\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    double                        minSeconds = 0.5;
+    int                           threads = 0;
+    std::string                   filter;
+    std::map<std::string, double> budgets;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (value == nullptr) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        char* end;
+        if (strcmp(arg, "--min-time") == 0) {
+            minSeconds = strtod(value, &end);
+        } else if (strcmp(arg, "--threads") == 0) {
+            threads = strtol(value, &end, 10);
+        } else if (strcmp(arg, "--filter") == 0) {
+            filter = value;
+            end = const_cast<char*>(value + strlen(value));
+        } else if (strcmp(arg, "--alloc-budget") == 0) {
+            const char* equals = strrchr(value, '=');
+            end = const_cast<char*>(value);
+            if (equals != nullptr && equals != value) {
+                double budget = strtod(equals + 1, &end);
+                if (equals[1] == '\0' || budget < 0) {
+                    end = const_cast<char*>(value);
+                }
+                budgets[std::string(value, equals)] = budget;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (*value == '\0' || *end != '\0' || minSeconds < 0 || threads < 0) {
+            fprintf(stderr, "bad value for %s\n", arg);
+            return 1;
+        }
+        ++i;
+    }
+
+    try {
+        int overBudget = Benchmarks(minSeconds, threads, filter, budgets).run();
+        return overBudget > 0 ? 1 : 0;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
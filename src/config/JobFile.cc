@@ -0,0 +1,616 @@
+#include "JobFile.hh"
+
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "../actions/ActionTable.hh"
+#include "../data/RecipeDatabase.hh"
+#include "../solver/operators/GeneticOperator.hh"
+#include "Json.hh"
+
+namespace {
+
+[[noreturn]] void fail(const JsonValue& value, const std::string& path,
+                       const std::string& message) {
+    throw std::invalid_argument("line " + std::to_string(value.line) + ": " + path +
+                                ": " + message);
+}
+
+void expectType(const JsonValue& value, const std::string& path, JsonValue::Type type) {
+    if (value.type != type) {
+        fail(value, path,
+             std::string("expected ") + jsonType2str(type) + ", got " +
+                 jsonType2str(value.type));
+    }
+}
+
+// Reads the members of a JSON object by name, and complains about the ones that
+// were never asked for once done.
+class Fields {
+   public:
+    Fields(const JsonValue& object, std::string path)
+        : _object(object), _path(std::move(path)), _used(object.object.size()) {
+        expectType(object, _path, JsonValue::Object);
+    }
+
+    const JsonValue* find(const char* key) {
+        for (int i = 0; i < _object.object.size(); ++i) {
+            if (_object.object[i].first == key) {
+                _used[i] = true;
+                return &_object.object[i].second;
+            }
+        }
+        return nullptr;
+    }
+
+    const JsonValue& get(const char* key) {
+        const JsonValue* value = find(key);
+        if (value == nullptr) {
+            fail(_object, _path, std::string("missing \"") + key + "\"");
+        }
+        return *value;
+    }
+
+    std::string path(const char* key) const {
+        return _path.empty() ? key : _path + "." + key;
+    }
+
+    int integer(const char* key, int min, int max) {
+        const JsonValue& value = get(key);
+        expect(value, key, JsonValue::Number);
+        if (value.number != std::floor(value.number)) {
+            fail(value, path(key), "expected an integer");
+        }
+        if (value.number < min || value.number > max) {
+            fail(value, path(key), outOfRange(min, max));
+        }
+        return static_cast<int>(value.number);
+    }
+
+    int integer(const char* key, int min, int max, int fallback) {
+        return find(key) ? integer(key, min, max) : fallback;
+    }
+
+    double number(const char* key, double min, double max, double fallback) {
+        const JsonValue* value = find(key);
+        if (value == nullptr) {
+            return fallback;
+        }
+        expect(*value, key, JsonValue::Number);
+        if (value->number < min || value->number > max) {
+            fail(*value, path(key), outOfRange(min, max));
+        }
+        return value->number;
+    }
+
+    bool boolean(const char* key, bool fallback) {
+        const JsonValue* value = find(key);
+        if (value == nullptr) {
+            return fallback;
+        }
+        expect(*value, key, JsonValue::Bool);
+        return value->boolean;
+    }
+
+    std::string string(const char* key, const std::string& fallback) {
+        const JsonValue* value = find(key);
+        if (value == nullptr) {
+            return fallback;
+        }
+        expect(*value, key, JsonValue::String);
+        return value->string;
+    }
+
+    // Object member to be read with a Fields of its own. An empty object if
+    // there is none, so that all its fields take their defaults.
+    const JsonValue& object(const char* key) {
+        static const JsonValue empty{.type = JsonValue::Object};
+        const JsonValue*       value = find(key);
+        return value ? *value : empty;
+    }
+
+    void done() const {
+        for (int i = 0; i < _object.object.size(); ++i) {
+            if (!_used[i]) {
+                const auto& [key, value] = _object.object[i];
+                fail(value, _path.empty() ? key : _path + "." + key, "unknown field");
+            }
+        }
+    }
+
+   private:
+    // Paths are only put together for error messages, they are slow to build.
+    void expect(const JsonValue& value, const char* key, JsonValue::Type type) const {
+        if (value.type != type) {
+            expectType(value, path(key), type);
+        }
+    }
+
+    static std::string outOfRange(double min, double max) {
+        char message[96];
+        snprintf(message, sizeof(message), "must be between %g and %g", min, max);
+        return message;
+    }
+
+    const JsonValue&  _object;
+    std::string       _path;
+    std::vector<bool> _used;
+};
+
+constexpr int MAX_INT = std::numeric_limits<int>::max();
+
+ActionId readAction(const JsonValue& value, const std::string& path, int index) {
+    static const std::unordered_map<std::string, ActionId> byShortName = [] {
+        std::unordered_map<std::string, ActionId> map;
+        for (const Action& action : ALL_ACTIONS) {
+            map.emplace(action.shortName, action.id);
+        }
+        return map;
+    }();
+
+    auto it = byShortName.find(value.string);
+    if (value.type != JsonValue::String || it == byShortName.end()) {
+        std::string actionPath = path + "[" + std::to_string(index) + "]";
+        expectType(value, actionPath, JsonValue::String);
+        fail(value, actionPath, "unknown action \"" + value.string + "\"");
+    }
+    return it->second;
+}
+
+std::vector<ActionId> readActions(const JsonValue& value, const std::string& path) {
+    expectType(value, path, JsonValue::Array);
+
+    std::vector<ActionId> actions;
+    actions.reserve(value.array.size());
+    for (int i = 0; i < value.array.size(); ++i) {
+        actions.push_back(readAction(value.array[i], path, i));
+    }
+    return actions;
+}
+
+Recipe readRecipe(Fields&& f) {
+    Recipe recipe{
+        .baseLevel = f.integer("baseLevel", 1, MAX_INT),
+        .level = f.integer("level", 1, MAX_INT),
+        .difficulty = f.integer("difficulty", 1, MAX_INT),
+        .durability = f.integer("durability", 1, MAX_INT),
+        .startQuality = f.integer("startQuality", 0, MAX_INT, 0),
+        .safetyMargin = f.integer("safetyMargin", 0, 100, 0),
+        .maxQuality = f.integer("maxQuality", 1, MAX_INT),
+        .suggestedCraftsmanship = f.integer("suggestedCraftsmanship", 0, MAX_INT),
+        .suggestedControl = f.integer("suggestedControl", 0, MAX_INT),
+        .progressDivider = f.integer("progressDivider", 1, MAX_INT),
+        .progressModifier = f.integer("progressModifier", 1, MAX_INT, 100),
+        .qualityDivider = f.integer("qualityDivider", 1, MAX_INT),
+        .qualityModifier = f.integer("qualityModifier", 1, MAX_INT, 100),
+        .stars = f.integer("stars", 0, MAX_INT, 0),
+    };
+    f.done();
+    return recipe;
+}
+
+// A recipe object, or the id or name of a recipe in the database.
+Recipe readRecipe(const JsonValue& value, const std::string& path,
+                  const RecipeDatabase* recipes) {
+    if (value.type != JsonValue::Number && value.type != JsonValue::String) {
+        return readRecipe(Fields(value, path));
+    }
+    if (recipes == nullptr) {
+        fail(value, path, "recipes by id or name need a recipe database");
+    }
+
+    const Recipe* recipe;
+    if (value.type == JsonValue::Number) {
+        if (value.number != std::floor(value.number) || value.number < 0 ||
+            value.number > MAX_INT) {
+            fail(value, path, "expected a recipe id");
+        }
+        recipe = recipes->findById(static_cast<int>(value.number));
+    } else {
+        recipe = recipes->findByName(value.string);
+    }
+    if (recipe == nullptr) {
+        fail(value, path, "no such recipe in the recipe database");
+    }
+    return *recipe;
+}
+
+CrafterClass readClass(const JsonValue& value, const std::string& path) {
+    expectType(value, path, JsonValue::String);
+    for (int cls = Carpenter; cls <= Culinarian; ++cls) {
+        if (value.string == class2str(static_cast<CrafterClass>(cls))) {
+            return static_cast<CrafterClass>(cls);
+        }
+    }
+    fail(value, path, "unknown class \"" + value.string + "\"");
+}
+
+Crafter readCrafter(Fields&& f) {
+    Crafter crafter{
+        .cls = readClass(f.get("class"), f.path("class")),
+        .level = f.integer("level", 1, 90),
+        .craftsmanship = f.integer("craftsmanship", 0, MAX_INT),
+        .control = f.integer("control", 0, MAX_INT),
+        .craftingPoints = f.integer("craftingPoints", 0, MAX_INT),
+        .isSpecialist = f.boolean("specialist", false),
+        .actions = readActions(f.get("actions"), f.path("actions")),
+    };
+    if (crafter.actions.empty()) {
+        fail(f.get("actions"), f.path("actions"), "no actions");
+    }
+    f.done();
+    return crafter;
+}
+
+SolverVars readSolverVars(Fields&& f) {
+    SolverVars vars{
+        .population = f.integer("population", 1, MAX_INT, 8000),
+        .generations = f.integer("generations", 0, MAX_INT, 2000),
+        .subPopulations = f.integer("subPopulations", 1, MAX_INT, 30),
+        .maxStagnationCounter = f.integer("maxStagnationCounter", 1, MAX_INT, 20),
+        .penaltyWeight = f.number("penaltyWeight", 0, HUGE_VAL, 10000),
+        .solveForCompletion = f.boolean("solveForCompletion", false),
+        .remainerCPFitnessValue = f.number("remainerCPFitnessValue", 0, HUGE_VAL, 10),
+        .remainerDuraFitnessValue =
+            f.number("remainerDuraFitnessValue", 0, HUGE_VAL, 100),
+        .probCrossover = f.number("probCrossover", 0, 1, 0.5),
+        .probMutation = f.number("probMutation", 0, 1, 0.2),
+        .maxSubSeqLength = f.integer("maxSubSeqLength", 1, MAX_INT, 4),
+        .eliminateDuplicates = f.boolean("eliminateDuplicates", true),
+    };
+    if (vars.subPopulations > vars.population) {
+        fail(f.get("subPopulations"), f.path("subPopulations"),
+             "more subpopulations than individuals");
+    }
+    f.done();
+    return vars;
+}
+
+OperatorVars readOperatorVars(Fields&& f) {
+    OperatorVars vars{
+        .adaptive = f.boolean("adaptive", false),
+        .learningRate = f.number("learningRate", 0, 1, 0.3),
+        .adaptationRate = f.number("adaptationRate", 0, 1, 0.3),
+        .minProbability = f.number("minProbability", 0, 1.0 / MUTATION_COUNT, 0.02),
+    };
+    f.done();
+    return vars;
+}
+
+TerminationVars readTerminationVars(Fields&& f) {
+    TerminationVars vars{
+        .timeLimit = f.number("timeLimit", 0, HUGE_VAL, 0),
+        .targetFitness =
+            f.find("targetFitness")
+                ? std::optional(f.number("targetFitness", -HUGE_VAL, HUGE_VAL, 0))
+                : std::nullopt,
+        .maxStaleGenerations = f.integer("maxStaleGenerations", 0, MAX_INT, 0),
+        .stopAtMaxQuality = f.boolean("stopAtMaxQuality", false),
+        .anytime = f.boolean("anytime", false),
+    };
+    f.done();
+    return vars;
+}
+
+SolverEngine readEngine(Fields& f) {
+    const JsonValue* value = f.find("engine");
+    if (value == nullptr) {
+        return Genetic;
+    }
+
+    expectType(*value, f.path("engine"), JsonValue::String);
+    if (value->string == "genetic") {
+        return Genetic;
+    } else if (value->string == "beam") {
+        return Beam;
+    } else if (value->string == "mcts") {
+        return Mcts;
+    }
+    fail(*value, f.path("engine"), "unknown engine \"" + value->string + "\"");
+}
+
+BeamSearchVars readBeamVars(Fields&& f) {
+    BeamSearchVars vars{
+        .beamWidth = f.integer("beamWidth", 1, MAX_INT, 2000),
+        .maxDepth = f.integer("maxDepth", 0, MAX_INT, 0),
+    };
+    f.done();
+    return vars;
+}
+
+MctsVars readMctsVars(Fields&& f) {
+    MctsVars vars{
+        .iterations = f.integer("iterations", 1, MAX_INT, 200000),
+        .exploration = f.number("exploration", 0, HUGE_VAL, 0),
+        .maxMemoryMB = f.integer("maxMemoryMB", 0, MAX_INT, 256),
+        .minPolicyVisits = f.integer("minPolicyVisits", 1, MAX_INT, 50),
+        .policyBuckets = f.integer("policyBuckets", 0, 64, 8),
+    };
+    f.done();
+    return vars;
+}
+
+PolishVars readPolishVars(Fields&& f) {
+    PolishVars vars{
+        .maxEdits = f.integer("maxEdits", 0, 2, 2),
+        .eliteInterval = f.integer("eliteInterval", 0, MAX_INT, 0),
+    };
+    f.done();
+    return vars;
+}
+
+CheckpointVars readCheckpointVars(Fields&& f) {
+    CheckpointVars vars{
+        .path = f.string("path", ""),
+        .interval = f.integer("interval", 0, MAX_INT, 0),
+        .resume = f.boolean("resume", false),
+    };
+    f.done();
+    return vars;
+}
+
+// Given, or else told by the file's extension.
+TelemetryFormat readTelemetryFormat(Fields& f, const std::string& path) {
+    const JsonValue* value = f.find("format");
+    if (value == nullptr) {
+        const std::string csv = ".csv";
+        return path.size() >= csv.size() &&
+                       path.compare(path.size() - csv.size(), csv.size(), csv) == 0
+                   ? TelemetryCsv
+                   : TelemetryJsonl;
+    }
+
+    expectType(*value, f.path("format"), JsonValue::String);
+    if (value->string == "csv") {
+        return TelemetryCsv;
+    } else if (value->string == "jsonl") {
+        return TelemetryJsonl;
+    }
+    fail(*value, f.path("format"), "unknown format \"" + value->string + "\"");
+}
+
+TelemetryVars readTelemetryVars(Fields&& f) {
+    TelemetryVars vars{
+        .path = f.string("path", ""),
+        .interval = f.integer("interval", 1, MAX_INT, 1),
+    };
+    vars.format = readTelemetryFormat(f, vars.path);
+    f.done();
+    return vars;
+}
+
+CacheVars readCacheVars(Fields&& f) {
+    CacheVars vars{
+        .path = f.string("path", ""),
+        .lookup = f.boolean("lookup", true),
+        .seedFraction = f.number("seedFraction", 0, 1, 0.1),
+        .seedNeighbours = f.integer("seedNeighbours", 0, MAX_INT, 5),
+    };
+    f.done();
+    return vars;
+}
+
+BatchJob readJob(Fields&& f, const std::string& defaultName,
+                 const RecipeDatabase* recipes) {
+    BatchJob job{
+        .name = f.string("name", defaultName),
+        .settings{
+            .recipe = readRecipe(f.get("recipe"), f.path("recipe"), recipes),
+            .crafter = readCrafter(Fields(f.get("crafter"), f.path("crafter"))),
+            .maxTrickUses = f.integer("maxTrickUses", 0, MAX_INT, 0),
+            .reliabilityPercent = f.integer("reliabilityPercent", 0, 100, 100),
+            .maxLength = f.integer("maxLength", 0, MAX_INT, 0),
+            .useConditions = f.boolean("useConditions", false),
+            .solver = readSolverVars(Fields(f.object("solver"), f.path("solver"))),
+            .operators =
+                readOperatorVars(Fields(f.object("operators"), f.path("operators"))),
+            .termination = readTerminationVars(
+                Fields(f.object("termination"), f.path("termination"))),
+            .sequence = f.find("sequence")
+                            ? readActions(f.get("sequence"), f.path("sequence"))
+                            : std::vector<ActionId>{},
+            .debug = f.boolean("debug", false),
+            .quiet = f.boolean("quiet", false),
+            .engine = readEngine(f),
+            .beam = readBeamVars(Fields(f.object("beam"), f.path("beam"))),
+            .mcts = readMctsVars(Fields(f.object("mcts"), f.path("mcts"))),
+            .polish = readPolishVars(Fields(f.object("polish"), f.path("polish"))),
+            .checkpoint =
+                readCheckpointVars(Fields(f.object("checkpoint"), f.path("checkpoint"))),
+            .cache = readCacheVars(Fields(f.object("cache"), f.path("cache"))),
+            .telemetry =
+                readTelemetryVars(Fields(f.object("telemetry"), f.path("telemetry"))),
+            .threads = f.integer("threads", 0, MAX_INT, 0),
+        },
+        .priority = f.integer("priority", std::numeric_limits<int>::min(), MAX_INT, 0),
+    };
+    f.done();
+    return job;
+}
+
+StatRange readStatRange(Fields& f, const char* key, int fixed) {
+    const JsonValue* value = f.find(key);
+    if (value == nullptr) {
+        return {.min = fixed, .max = fixed, .step = 1};
+    }
+
+    Fields    range(*value, f.path(key));
+    StatRange vars{
+        .min = range.integer("min", 0, MAX_INT),
+        .max = range.integer("max", 0, MAX_INT),
+        .step = range.integer("step", 1, MAX_INT),
+    };
+    range.done();
+    if (vars.min > vars.max) {
+        fail(*value, f.path(key), "min is above max");
+    }
+    return vars;
+}
+
+SweepMode readSweepMode(Fields& f) {
+    const JsonValue* value = f.find("mode");
+    if (value == nullptr) {
+        return GridSweep;
+    }
+
+    expectType(*value, f.path("mode"), JsonValue::String);
+    if (value->string == "grid") {
+        return GridSweep;
+    } else if (value->string == "craftsmanship") {
+        return CraftsmanshipSearch;
+    } else if (value->string == "control") {
+        return ControlSearch;
+    } else if (value->string == "craftingPoints") {
+        return CraftingPointsSearch;
+    }
+    fail(*value, f.path("mode"), "unknown mode \"" + value->string + "\"");
+}
+
+// The "crafters" of a file, or just the job's crafter if there are none.
+std::vector<Crafter> readCrafters(Fields& f, const Crafter& jobCrafter) {
+    const JsonValue* value = f.find("crafters");
+    if (value == nullptr) {
+        return {jobCrafter};
+    }
+
+    expectType(*value, "crafters", JsonValue::Array);
+    std::vector<Crafter> crafters;
+    crafters.reserve(value->array.size());
+    for (int i = 0; i < value->array.size(); ++i) {
+        std::string path = "crafters[" + std::to_string(i) + "]";
+        crafters.push_back(readCrafter(Fields(value->array[i], path)));
+    }
+    return crafters;
+}
+
+std::vector<ActionSequence> readMacros(const JsonValue& value, const std::string& path) {
+    expectType(value, path, JsonValue::Array);
+
+    std::vector<ActionSequence> macros;
+    macros.reserve(value.array.size());
+    for (int i = 0; i < value.array.size(); ++i) {
+        std::string macroPath = path + "[" + std::to_string(i) + "]";
+        macros.push_back(readActions(value.array[i], macroPath));
+    }
+    return macros;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::invalid_argument(path + ": could not open the file");
+    }
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+std::vector<BatchJob> parseJobs(const std::string& text, const std::string& origin,
+                                const RecipeDatabase* recipes) {
+    std::vector<BatchJob> jobs;
+    try {
+        JsonValue document = parseJson(text);
+        if (document.type == JsonValue::Array) {
+            jobs.reserve(document.array.size());
+            for (int i = 0; i < document.array.size(); ++i) {
+                std::string path = "[" + std::to_string(i) + "]";
+                jobs.push_back(readJob(Fields(document.array[i], path), origin + path,
+                                       recipes));
+            }
+        } else {
+            jobs.push_back(readJob(Fields(document, ""), origin, recipes));
+        }
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(origin + ": " + e.what());
+    }
+    return jobs;
+}
+
+BatchJob parseJob(const JsonValue& job, const std::string& path,
+                  const RecipeDatabase* recipes) {
+    return readJob(Fields(job, path), path, recipes);
+}
+
+std::vector<BatchJob> loadJobFile(const std::string&    path,
+                                  const RecipeDatabase* recipes) {
+    return parseJobs(readFile(path), path, recipes);
+}
+
+SweepJob loadSweepFile(const std::string& path, const RecipeDatabase* recipes) {
+    try {
+        JsonValue document = parseJson(readFile(path));
+        Fields    f(document, "");
+        BatchJob  job = parseJob(f.get("job"), "job", recipes);
+
+        // Every point is a solve of its own, and they would all share the files.
+        for (const char* key : {"checkpoint", "telemetry"}) {
+            if (const JsonValue* value = f.get("job").find(key)) {
+                fail(*value, std::string("job.") + key, "not supported in a sweep");
+            }
+        }
+
+        // Stats without a range stay at the job's values.
+        const Crafter& crafter = job.settings.crafter;
+
+        SweepVars sweep{
+            .craftsmanship = readStatRange(f, "craftsmanship", crafter.craftsmanship),
+            .control = readStatRange(f, "control", crafter.control),
+            .craftingPoints = readStatRange(f, "craftingPoints", crafter.craftingPoints),
+            .mode = readSweepMode(f),
+            .maxJobs = f.integer("jobs", 0, MAX_INT, 0),
+        };
+        f.done();
+        return {.job = std::move(job), .sweep = sweep};
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(path + ": " + e.what());
+    }
+}
+
+ValidationJob loadValidationFile(const std::string& path, const RecipeDatabase* recipes) {
+    try {
+        JsonValue     document = parseJson(readFile(path));
+        Fields        f(document, "");
+        ValidationJob validation{
+            .job = parseJob(f.get("job"), "job", recipes),
+            .validation{
+                .monteCarloRuns = f.integer("monteCarloRuns", 0, MAX_INT, 0),
+                .seed = static_cast<unsigned>(f.number("seed", 0, UINT_MAX, 0)),
+                .threads = f.integer("threads", 0, MAX_INT, 0),
+            },
+        };
+
+        validation.crafters = readCrafters(f, validation.job.settings.crafter);
+        validation.macros = readMacros(f.get("macros"), "macros");
+        f.done();
+        return validation;
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(path + ": " + e.what());
+    }
+}
+
+LibraryJob loadLibraryFile(const std::string& path, const RecipeDatabase* recipes) {
+    try {
+        JsonValue  document = parseJson(readFile(path));
+        Fields     f(document, "");
+        LibraryJob library{
+            .job = parseJob(f.get("job"), "job", recipes),
+            .path = f.string("path", ""),
+        };
+        library.crafters = readCrafters(f, library.job.settings.crafter);
+        library.macros = f.find("macros") ? readMacros(f.get("macros"), "macros")
+                                          : std::vector<ActionSequence>{};
+        library.targetQuality = f.integer("targetQuality", 0, MAX_INT,
+                                          library.job.settings.recipe.maxQuality);
+        f.done();
+        return library;
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(path + ": " + e.what());
+    }
+}
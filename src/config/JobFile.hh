@@ -0,0 +1,79 @@
+#ifndef CONFIG_JOBFILE_HH_
+#define CONFIG_JOBFILE_HH_
+
+#include <string>
+#include <vector>
+
+#include "../solver/Individual.hh"
+#include "../solver/batch/BatchSolver.hh"
+#include "../solver/sweep/SweepVars.hh"
+#include "../solver/validate/ValidationVars.hh"
+#include "Json.hh"
+
+class RecipeDatabase;
+
+// Job files are JSON: either one job object or an array of them. A job holds
+// the fields of SolverSettings under the same names, plus an optional "name"
+// and "priority". Recipe and crafter are required, everything else defaults
+// to the values of a regular solve. Actions are given by their short names,
+// e.g. "muscleMemory", the crafter class by its abbreviation, e.g. "CUL", and
+// the engine as "genetic", "beam" or "mcts". Given a recipe database, the
+// recipe may also be the id or the name of a recipe in it.
+//
+// Unknown fields, wrong types and out-of-range values are errors: they throw
+// std::invalid_argument naming the file, the line and the field.
+std::vector<BatchJob> loadJobFile(const std::string&    path,
+                                  const RecipeDatabase* recipes);
+
+// As loadJobFile(), from a string. Jobs without a name are named after
+// `origin` and their position in it.
+std::vector<BatchJob> parseJobs(const std::string& text, const std::string& origin,
+                                const RecipeDatabase* recipes);
+
+// One job object from an already parsed document. `path` is where it sits in
+// the document, for error messages, and its name if it has none.
+BatchJob parseJob(const JsonValue& job, const std::string& path,
+                  const RecipeDatabase* recipes);
+
+struct SweepJob {
+    BatchJob  job;
+    SweepVars sweep;
+};
+
+// Sweep files are JSON objects holding a "job" as in a job file, a range
+// {"min", "max", "step"} for any of "craftsmanship", "control" and
+// "craftingPoints", the "mode" ("grid", or the stat to binary search) and the
+// number of "jobs" to run at once. Stats without a range stay at the job's.
+// The job can't have a "checkpoint" or "telemetry": points don't share them.
+SweepJob loadSweepFile(const std::string& path, const RecipeDatabase* recipes);
+
+struct ValidationJob {
+    BatchJob                    job;
+    std::vector<Crafter>        crafters;
+    std::vector<ActionSequence> macros;
+    ValidationVars              validation;
+};
+
+// Validation files are JSON objects holding a "job" as in a job file for the
+// recipe and the rules of the craft, the "crafters" to check against (the
+// job's crafter if left out), the "macros" as arrays of actions, the number of
+// "monteCarloRuns" per macro and crafter, their "seed" and the most "threads"
+// to use.
+ValidationJob loadValidationFile(const std::string& path, const RecipeDatabase* recipes);
+
+struct LibraryJob {
+    BatchJob                    job;
+    std::string                 path;
+    std::vector<Crafter>        crafters;
+    std::vector<ActionSequence> macros;
+    int                         targetQuality;
+};
+
+// Library files are JSON objects holding a "job" as in a job file for the
+// recipe, the rules and the crafter level, the "path" of a saved macro library
+// to extend, the "macros" to add to it, the "targetQuality" they must reach
+// (the recipe's max quality if left out) and the "crafters" to find the best
+// macro for (the job's crafter if left out).
+LibraryJob loadLibraryFile(const std::string& path, const RecipeDatabase* recipes);
+
+#endif  // CONFIG_JOBFILE_HH_
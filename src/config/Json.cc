@@ -0,0 +1,373 @@
+#include "Json.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+
+class Parser {
+   public:
+    explicit Parser(const std::string& text)
+        : _p(text.c_str()), _end(text.c_str() + text.size()), _line(1) {}
+
+    JsonValue document() {
+        JsonValue value = parseValue(0);
+        skipSpace();
+        if (_p != _end) {
+            fail("unexpected text after the document");
+        }
+        return value;
+    }
+
+   private:
+    // Deep enough for any job file, shallow enough to never run out of stack.
+    static constexpr int MAX_DEPTH = 64;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::invalid_argument("line " + std::to_string(_line) + ": " + message);
+    }
+
+    void skipSpace() {
+        while (_p != _end) {
+            if (*_p == '\n') {
+                _line += 1;
+            } else if (*_p != ' ' && *_p != '\t' && *_p != '\r') {
+                return;
+            }
+            ++_p;
+        }
+    }
+
+    bool consume(const char* word) {
+        const char* p = _p;
+        for (; *word != '\0'; ++word, ++p) {
+            if (p == _end || *p != *word) {
+                return false;
+            }
+        }
+        _p = p;
+        return true;
+    }
+
+    JsonValue parseValue(int depth) {
+        if (depth > MAX_DEPTH) {
+            fail("nested too deeply");
+        }
+
+        skipSpace();
+        if (_p == _end) {
+            fail("unexpected end of file");
+        }
+
+        JsonValue value;
+        value.line = _line;
+
+        switch (*_p) {
+            case '{':
+                value.type = JsonValue::Object;
+                parseObject(value, depth);
+                break;
+            case '[':
+                value.type = JsonValue::Array;
+                parseArray(value, depth);
+                break;
+            case '"':
+                value.type = JsonValue::String;
+                value.string = parseString();
+                break;
+            case 't':
+            case 'f':
+                value.type = JsonValue::Bool;
+                value.boolean = *_p == 't';
+                if (!consume(value.boolean ? "true" : "false")) {
+                    fail("invalid literal");
+                }
+                break;
+            case 'n':
+                if (!consume("null")) {
+                    fail("invalid literal");
+                }
+                break;
+            default:
+                value.type = JsonValue::Number;
+                value.number = parseNumber();
+                break;
+        }
+        return value;
+    }
+
+    void parseObject(JsonValue& value, int depth) {
+        ++_p;
+        skipSpace();
+        if (_p != _end && *_p == '}') {
+            ++_p;
+            return;
+        }
+
+        while (true) {
+            skipSpace();
+            if (_p == _end || *_p != '"') {
+                fail("expected a member name");
+            }
+            std::string key = parseString();
+
+            skipSpace();
+            if (_p == _end || *_p != ':') {
+                fail("expected ':' after \"" + key + "\"");
+            }
+            ++_p;
+            value.object.emplace_back(std::move(key), parseValue(depth + 1));
+
+            skipSpace();
+            if (_p != _end && *_p == ',') {
+                ++_p;
+            } else if (_p != _end && *_p == '}') {
+                ++_p;
+                return;
+            } else {
+                fail("expected ',' or '}'");
+            }
+        }
+    }
+
+    void parseArray(JsonValue& value, int depth) {
+        ++_p;
+        skipSpace();
+        if (_p != _end && *_p == ']') {
+            ++_p;
+            return;
+        }
+
+        while (true) {
+            value.array.push_back(parseValue(depth + 1));
+
+            skipSpace();
+            if (_p != _end && *_p == ',') {
+                ++_p;
+            } else if (_p != _end && *_p == ']') {
+                ++_p;
+                return;
+            } else {
+                fail("expected ',' or ']'");
+            }
+        }
+    }
+
+    std::string parseString() {
+        ++_p;
+        std::string s;
+        while (true) {
+            // Copy everything up to the next quote or escape in one go.
+            const char* run = _p;
+            while (_p != _end && *_p != '"' && *_p != '\\' && *_p != '\n') {
+                ++_p;
+            }
+            s.append(run, _p);
+
+            if (_p == _end || *_p == '\n') {
+                fail("unterminated string");
+            }
+            if (*_p++ == '"') {
+                return s;
+            }
+
+            if (_p == _end) {
+                fail("unterminated string");
+            }
+            switch (char e = *_p++) {
+                case '"':
+                case '\\':
+                case '/':
+                    s += e;
+                    break;
+                case 'b':
+                    s += '\b';
+                    break;
+                case 'f':
+                    s += '\f';
+                    break;
+                case 'n':
+                    s += '\n';
+                    break;
+                case 'r':
+                    s += '\r';
+                    break;
+                case 't':
+                    s += '\t';
+                    break;
+                case 'u':
+                    appendCodePoint(s, parseHex4());
+                    break;
+                default:
+                    fail("invalid escape in string");
+            }
+        }
+    }
+
+    unsigned parseHex4() {
+        if (_end - _p < 4) {
+            fail("invalid \\u escape");
+        }
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *_p++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                code |= c - 'A' + 10;
+            } else {
+                fail("invalid \\u escape");
+            }
+        }
+        return code;
+    }
+
+    // Encodes as UTF-8. Surrogate pairs are combined; lone ones are kept as is.
+    void appendCodePoint(std::string& s, unsigned code) {
+        if (code >= 0xD800 && code < 0xDC00 && _end - _p >= 6 && _p[0] == '\\' &&
+            _p[1] == 'u') {
+            const char* save = _p;
+            _p += 2;
+            unsigned low = parseHex4();
+            if (low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            } else {
+                _p = save;
+            }
+        }
+
+        if (code < 0x80) {
+            s += char(code);
+        } else if (code < 0x800) {
+            s += char(0xC0 | (code >> 6));
+            s += char(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            s += char(0xE0 | (code >> 12));
+            s += char(0x80 | ((code >> 6) & 0x3F));
+            s += char(0x80 | (code & 0x3F));
+        } else {
+            s += char(0xF0 | (code >> 18));
+            s += char(0x80 | ((code >> 12) & 0x3F));
+            s += char(0x80 | ((code >> 6) & 0x3F));
+            s += char(0x80 | (code & 0x3F));
+        }
+    }
+
+    double parseNumber() {
+        // Check the JSON grammar first, strtod() accepts more than that.
+        const char* p = _p;
+        if (p != _end && *p == '-') {
+            ++p;
+        }
+        if (p == _end || *p < '0' || *p > '9') {
+            fail("unexpected character");
+        }
+        if (*p == '0') {
+            ++p;
+        } else {
+            while (p != _end && *p >= '0' && *p <= '9') {
+                ++p;
+            }
+        }
+        if (p != _end && *p == '.') {
+            ++p;
+            if (p == _end || *p < '0' || *p > '9') {
+                fail("invalid number");
+            }
+            while (p != _end && *p >= '0' && *p <= '9') {
+                ++p;
+            }
+        }
+        if (p != _end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            if (p != _end && (*p == '+' || *p == '-')) {
+                ++p;
+            }
+            if (p == _end || *p < '0' || *p > '9') {
+                fail("invalid number");
+            }
+            while (p != _end && *p >= '0' && *p <= '9') {
+                ++p;
+            }
+        }
+
+        // The text is null-terminated, so strtod() stops at the end at the latest.
+        double x = std::strtod(_p, nullptr);
+        _p = p;
+        return x;
+    }
+
+    const char* _p;
+    const char* _end;
+    int         _line;
+};
+
+}  // namespace
+
+const JsonValue* JsonValue::find(const std::string& key) const {
+    for (const auto& [name, value] : object) {
+        if (name == key) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+const char* jsonType2str(JsonValue::Type type) {
+    switch (type) {
+        case JsonValue::Null:
+            return "null";
+        case JsonValue::Bool:
+            return "a boolean";
+        case JsonValue::Number:
+            return "a number";
+        case JsonValue::String:
+            return "a string";
+        case JsonValue::Array:
+            return "an array";
+        case JsonValue::Object:
+            return "an object";
+    }
+    return "unknown";
+}
+
+JsonValue parseJson(const std::string& text) { return Parser(text).document(); }
+
+std::string quoteJson(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
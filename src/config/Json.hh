@@ -0,0 +1,41 @@
+#ifndef CONFIG_JSON_HH_
+#define CONFIG_JSON_HH_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsed JSON document. Objects keep their members in file order, which is
+// all the job loader needs and avoids building a map per object.
+struct JsonValue {
+    enum Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Type                                           type = Null;
+    bool                                           boolean = false;
+    double                                         number = 0;
+    std::string                                    string;
+    std::vector<JsonValue>                         array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+    // Where the value starts, for error messages.
+    int line = 0;
+
+    // Member of an object, or null if there is none.
+    const JsonValue* find(const std::string& key) const;
+};
+
+const char* jsonType2str(JsonValue::Type type);
+
+// Throws std::invalid_argument naming the line of the first error.
+JsonValue parseJson(const std::string& text);
+
+// The text as a JSON string literal, quotes included.
+std::string quoteJson(const std::string& text);
+
+#endif  // CONFIG_JSON_HH_
@@ -0,0 +1,402 @@
+#include "Daemon.hh"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "../actions/ActionTable.hh"
+#include "../config/JobFile.hh"
+#include "../config/Json.hh"
+#include "../solver/Solver.hh"
+#include "../solver/parallel/ThreadPool.hh"
+
+namespace {
+
+// Longer lines are answered with an error and skipped.
+constexpr size_t MAX_LINE = 1 << 20;
+
+// Start of a reply object; the caller appends fields and the closing brace.
+std::string reply(const std::string& id, const char* event) {
+    return "{\"id\":" + quoteJson(id) + ",\"event\":\"" + event + "\"";
+}
+
+std::string errorReply(const std::string& id, const char* event,
+                       const std::string& error) {
+    return reply(id, event) + ",\"error\":" + quoteJson(error) + "}";
+}
+
+std::string number(double x) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.10g", x);
+    return text;
+}
+
+std::string macroFields(const Individual& best) {
+    std::string fields = ",\"fitness\":" + number(best.fitness.fitness);
+    fields += ",\"sequence\":[";
+    for (int i = 0; i < best.sequence.size(); ++i) {
+        fields += i > 0 ? ",\"" : "\"";
+        fields += ALL_ACTIONS[best.sequence[i]].shortName;
+        fields += '"';
+    }
+    return fields + "]";
+}
+
+}  // namespace
+
+Daemon::Daemon(ThreadPool& pool, DaemonVars vars, const RecipeDatabase* recipes)
+    : _pool(pool), _vars(std::move(vars)), _recipes(recipes), _stopping(false) {
+    // Replies to clients that went away must not kill the daemon.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!_vars.cachePath.empty()) {
+        _cache = std::make_unique<SolutionCache>(_vars.cachePath);
+    }
+
+    // Runners are threads of their own that share the pool for their solves, so
+    // there may be more of them than pool threads.
+    int runners = _vars.maxActive > 0 ? _vars.maxActive : _pool.size();
+    for (int i = 0; i < runners; ++i) {
+        _runners.emplace_back(&Daemon::runnerLoop, this);
+    }
+}
+
+Daemon::~Daemon() {
+    {
+        std::unique_lock lock(_mutex);
+        _stopping = true;
+        for (const auto& request : _queue) {
+            request->cancelled = true;
+        }
+        for (Request* request : _running) {
+            request->cancelled = true;
+        }
+        _queued.notify_all();
+
+        // Clients stop being read from, and their threads end once their
+        // requests are cancelled.
+        for (int client : _clients) {
+            shutdown(client, SHUT_RD);
+        }
+        _finished.wait(lock, [this]() { return _clients.empty(); });
+    }
+    for (auto& runner : _runners) {
+        runner.join();
+    }
+}
+
+void Daemon::serve(int in, int out) {
+    auto connection = std::make_shared<Connection>();
+    connection->out = out;
+
+    readRequests(connection, in);
+    waitUntilIdle(*connection);
+}
+
+void Daemon::listen(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0) {
+        throw std::runtime_error("Could not create a socket");
+    }
+    // A socket left behind by an earlier daemon is replaced, other files are not.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(server, 64) != 0) {
+        close(server);
+        throw std::runtime_error("Could not listen on " + path + ": " + strerror(errno));
+    }
+
+    while (true) {
+        int client = accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+                continue;
+            }
+            // Out of descriptors or memory until some client goes away.
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+                errno == ENOMEM) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            close(server);
+            throw std::runtime_error("Could not accept on " + path + ": " +
+                                     strerror(errno));
+        }
+
+        {
+            std::lock_guard lock(_mutex);
+            _clients.insert(client);
+        }
+        // Clients are served until they disconnect. The destructor waits for
+        // them to be done with the daemon.
+        std::thread([this, client]() {
+            auto connection = std::make_shared<Connection>();
+            connection->out = client;
+
+            readRequests(connection, client);
+            cancelAll(*connection);
+            waitUntilIdle(*connection);
+
+            std::lock_guard lock(_mutex);
+            _clients.erase(client);
+            close(client);
+            _finished.notify_all();
+        }).detach();
+    }
+}
+
+void Daemon::readRequests(const std::shared_ptr<Connection>& connection, int in) {
+    std::string buffer;
+    bool        skipping = false;
+    char        chunk[1 << 16];
+    while (true) {
+        ssize_t n = read(in, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        const char* begin = chunk;
+        const char* end = chunk + n;
+        while (begin < end) {
+            const char* newline = std::find(begin, end, '\n');
+            if (!skipping) {
+                buffer.append(begin, newline);
+            }
+            if (buffer.size() > MAX_LINE) {
+                send(*connection, errorReply("", "error", "request line too long"));
+                buffer.clear();
+                skipping = true;
+            }
+            if (newline == end) {
+                break;
+            }
+            if (!skipping) {
+                handleLine(connection, buffer);
+            }
+            buffer.clear();
+            skipping = false;
+            begin = newline + 1;
+        }
+    }
+    if (!skipping && !buffer.empty()) {
+        handleLine(connection, buffer);
+    }
+}
+
+void Daemon::handleLine(const std::shared_ptr<Connection>& connection,
+                        const std::string&                 line) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        return;
+    }
+
+    std::string id;
+    try {
+        JsonValue request = parseJson(line);
+        if (request.type != JsonValue::Object) {
+            throw std::invalid_argument("a request must be an object");
+        }
+        const JsonValue* idValue = request.find("id");
+        if (idValue == nullptr || idValue->type != JsonValue::String) {
+            throw std::invalid_argument("a request needs a string \"id\"");
+        }
+        id = idValue->string;
+
+        const JsonValue* job = request.find("solve");
+        const JsonValue* stop = request.find("cancel");
+        if (request.object.size() != 2 || (job == nullptr) == (stop == nullptr) ||
+            (stop != nullptr && (stop->type != JsonValue::Bool || !stop->boolean))) {
+            throw std::invalid_argument(
+                "a request holds an \"id\" and either \"solve\" or \"cancel\": true");
+        }
+        if (job != nullptr) {
+            // Files named by a client would be written with the daemon's rights,
+            // and by every request naming them at once.
+            for (const char* key : {"checkpoint", "telemetry", "cache"}) {
+                if (const JsonValue* value = job->find(key)) {
+                    throw std::invalid_argument(
+                        "line " + std::to_string(value->line) + ": solve." + key +
+                        ": not supported by the daemon");
+                }
+            }
+            BatchJob parsed = parseJob(*job, "solve", _recipes);
+            parsed.name = id;
+            submit(connection, id, std::move(parsed));
+        } else {
+            cancel(*connection, id);
+        }
+    } catch (const std::invalid_argument& e) {
+        send(*connection, errorReply(id, "error", e.what()));
+    }
+}
+
+void Daemon::submit(const std::shared_ptr<Connection>& connection,
+                    const std::string& id, BatchJob job) {
+    auto request = std::make_shared<Request>(id, std::move(job), connection);
+
+    const char* rejection = nullptr;
+    size_t      waiting;
+    {
+        std::lock_guard lock(_mutex);
+        // Queued requests that idle runners are about to take don't wait.
+        size_t idle = _runners.size() - _running.size();
+        waiting = _queue.size() > idle ? _queue.size() - idle : 0;
+        if (_stopping) {
+            rejection = "the daemon is stopping";
+        } else if (connection->requests.count(id) > 0) {
+            rejection = "a request with this id is running";
+        } else if (_queue.size() >= idle + _vars.maxQueued) {
+            rejection = "too many requests waiting";
+        } else {
+            connection->requests[id] = request;
+        }
+    }
+    if (rejection != nullptr) {
+        send(*connection, errorReply(id, "rejected", rejection));
+        return;
+    }
+
+    // Queued only once accepted, so that "accepted" always comes first.
+    send(*connection,
+         reply(id, "accepted") + ",\"waiting\":" + std::to_string(waiting) + "}");
+    {
+        std::lock_guard lock(_mutex);
+        // Higher priorities go first, equal ones in the order they came in.
+        auto position =
+            std::find_if(_queue.begin(), _queue.end(), [&](const auto& queued) {
+                return queued->job.priority < request->job.priority;
+            });
+        _queue.insert(position, request);
+    }
+    _queued.notify_one();
+}
+
+void Daemon::cancel(Connection& connection, const std::string& id) {
+    {
+        std::lock_guard lock(_mutex);
+        auto            it = connection.requests.find(id);
+        if (it != connection.requests.end()) {
+            it->second->cancelled = true;
+            return;
+        }
+    }
+    send(connection, errorReply(id, "error", "no such request"));
+}
+
+void Daemon::cancelAll(Connection& connection) {
+    std::lock_guard lock(_mutex);
+    for (const auto& [id, request] : connection.requests) {
+        request->cancelled = true;
+    }
+}
+
+void Daemon::waitUntilIdle(Connection& connection) {
+    std::unique_lock lock(_mutex);
+    _finished.wait(lock, [&]() { return connection.requests.empty(); });
+}
+
+void Daemon::runnerLoop() {
+    while (true) {
+        std::shared_ptr<Request> request;
+        {
+            std::unique_lock lock(_mutex);
+            _queued.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            request = std::move(_queue.front());
+            _queue.pop_front();
+            if (_stopping) {
+                request->cancelled = true;
+            }
+            _running.insert(request.get());
+        }
+
+        run(*request);
+
+        {
+            std::lock_guard lock(_mutex);
+            _running.erase(request.get());
+            request->connection->requests.erase(request->id);
+        }
+        _finished.notify_all();
+    }
+}
+
+void Daemon::run(Request& request) {
+    Connection& connection = *request.connection;
+    if (request.cancelled) {
+        send(connection, reply(request.id, "cancelled") + "}");
+        return;
+    }
+
+    SolverSettings settings(request.job.settings);
+    settings.quiet = true;
+    settings.debug = false;
+
+    try {
+        Solver solver(settings, _pool);
+        if (_cache) {
+            solver.setSolutionCache(*_cache);
+        }
+        solver.setStopFlag(request.cancelled);
+        solver.setBestCallback([&](const Individual& best, double seconds) {
+            send(connection, reply(request.id, "progress") + ",\"seconds\":" +
+                                 number(seconds) + macroFields(best) + "}");
+        });
+        solver.solve();
+
+        const MonteCarloStats& stats = solver.stats();
+        send(connection, reply(request.id, request.cancelled ? "cancelled" : "result") +
+                             macroFields(solver.best()) +
+                             ",\"successPercent\":" + number(stats.successPercent) +
+                             ",\"quality\":" + number(stats.avgStats.quality) +
+                             ",\"hqPercent\":" + number(stats.avgStats.hqPercent) + "}");
+    } catch (const std::exception& e) {
+        send(connection, errorReply(request.id, "error", e.what()));
+    }
+}
+
+void Daemon::send(Connection& connection, const std::string& line) {
+    std::lock_guard lock(connection.writeMutex);
+    if (connection.broken) {
+        return;
+    }
+
+    std::string text = line + "\n";
+    const char* data = text.data();
+    size_t      size = text.size();
+    while (size > 0) {
+        ssize_t n = write(connection.out, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            connection.broken = true;
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
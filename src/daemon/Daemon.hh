@@ -0,0 +1,116 @@
+#ifndef DAEMON_DAEMON_HH_
+#define DAEMON_DAEMON_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../solver/batch/BatchSolver.hh"
+#include "../solver/cache/SolutionCache.hh"
+
+class RecipeDatabase;
+class ThreadPool;
+
+struct DaemonVars {
+    // Solves running at once, 0 for as many as the pool has threads.
+    int maxActive;
+    // Solves waiting for a free slot. Requests beyond that are rejected.
+    int maxQueued;
+    // Solution cache of every request, none if empty.
+    std::string cachePath;
+};
+
+// Serves solve requests for as long as the process lives, so that the thread
+// pool and the solution caches stay warm from one request to the next.
+//
+// Requests and replies are JSON objects, one per line. A request is either
+//
+//   {"id": "a", "solve": {...}}   with a job as in a job file, or
+//   {"id": "a", "cancel": true}   for an earlier request of the same client.
+//
+// Jobs can't name a checkpoint, a telemetry file or a solution cache: clients
+// don't get to write files, and all requests share the daemon's cache.
+//
+// Every reply carries the id of its request and an "event": "accepted" or
+// "rejected" right away, "progress" with each new best macro of the genetic
+// engine, and finally "result", "cancelled" or "error". Results and
+// cancellations hold the macro found, its fitness and its Monte Carlo stats.
+class Daemon {
+   public:
+    Daemon(ThreadPool& pool, DaemonVars vars, const RecipeDatabase* recipes);
+    // Cancels what is still queued or running, and waits for the clients of
+    // listen() to be done.
+    ~Daemon();
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    // Serves the requests read from `in` until it ends, replying on `out`, and
+    // returns once all of them are finished.
+    void serve(int in, int out);
+
+    // Serves every client connecting to a Unix socket at path. The requests of a
+    // client are cancelled when it disconnects. Only returns by throwing
+    // std::runtime_error, if the socket can't be set up.
+    void listen(const std::string& path);
+
+   private:
+    struct Request;
+
+    // A client. Its requests are kept by id, for cancelling them.
+    struct Connection {
+        int        out;
+        std::mutex writeMutex;
+        bool       broken = false;
+
+        std::map<std::string, std::shared_ptr<Request>> requests;
+    };
+
+    struct Request {
+        Request(std::string id, BatchJob job, std::shared_ptr<Connection> connection)
+            : id(std::move(id)), job(std::move(job)), connection(std::move(connection)) {}
+
+        std::string                 id;
+        BatchJob                    job;
+        std::shared_ptr<Connection> connection;
+        std::atomic<bool>           cancelled{false};
+    };
+
+    void readRequests(const std::shared_ptr<Connection>& connection, int in);
+    void handleLine(const std::shared_ptr<Connection>& connection,
+                    const std::string&                 line);
+    void submit(const std::shared_ptr<Connection>& connection, const std::string& id,
+                BatchJob job);
+    void cancel(Connection& connection, const std::string& id);
+    void cancelAll(Connection& connection);
+    void waitUntilIdle(Connection& connection);
+
+    void runnerLoop();
+    void run(Request& request);
+
+    static void send(Connection& connection, const std::string& line);
+
+    ThreadPool&                    _pool;
+    DaemonVars                     _vars;
+    const RecipeDatabase*          _recipes;
+    std::unique_ptr<SolutionCache> _cache;
+
+    // Guards the queue, the requests of every connection and the clients.
+    std::mutex                           _mutex;
+    std::condition_variable              _queued;
+    std::condition_variable              _finished;
+    std::deque<std::shared_ptr<Request>> _queue;
+    std::set<Request*>                   _running;
+    std::set<int>                        _clients;
+    bool                                 _stopping;
+    std::vector<std::thread>             _runners;
+};
+
+#endif  // DAEMON_DAEMON_HH_
@@ -0,0 +1,426 @@
+#include "RecipeDatabase.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr char     MAGIC[8] = {'F', 'F', 'X', 'I', 'V', 'R', 'C', 'P'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t EMPTY = 0xFFFFFFFF;
+// Game recipe ids are five digits; this keeps the id table at most 64 MiB.
+constexpr int      MAX_ID = (1 << 24) - 1;
+constexpr int      FIELD_COUNT = sizeof(Recipe) / sizeof(int);
+
+// Recipes are mapped straight from the file, which only works while Recipe is a
+// plain row of ints.
+static_assert(std::is_standard_layout_v<Recipe> && sizeof(int) == 4 &&
+              sizeof(Recipe) == 14 * sizeof(int));
+
+// CSV column of each Recipe field, in member order.
+constexpr struct {
+    const char* name;
+    bool        required;
+} RECIPE_COLUMNS[FIELD_COUNT] = {
+    {"baseLevel", true},
+    {"level", true},
+    {"difficulty", true},
+    {"durability", true},
+    {"startQuality", false},
+    {"safetyMargin", false},
+    {"maxQuality", true},
+    {"suggestedCraftsmanship", true},
+    {"suggestedControl", true},
+    {"progressDivider", true},
+    {"progressModifier", true},
+    {"qualityDivider", true},
+    {"qualityModifier", true},
+    {"stars", true},
+};
+
+char lower(char c) { return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c; }
+
+bool sameName(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// FNV-1a of the name in lower case.
+uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(lower(c))) * 16777619u;
+    }
+    return hash;
+}
+
+// Splits CSV text into rows of fields. Fields may be quoted, with "" for a
+// quote, and quoted fields may hold commas and line breaks.
+class CsvReader {
+   public:
+    explicit CsvReader(const std::string& text) : _text(text), _pos(0), _line(1) {
+        if (_text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            _pos = 3;
+        }
+    }
+
+    // False at the end of the text. Blank lines are skipped.
+    bool next(std::vector<std::string>& fields) {
+        while (_pos < _text.size() && (_text[_pos] == '\n' || _text[_pos] == '\r')) {
+            _line += _text[_pos++] == '\n';
+        }
+        if (_pos == _text.size()) {
+            return false;
+        }
+
+        _rowLine = _line;
+        fields.clear();
+        while (true) {
+            fields.push_back(field());
+            if (_pos == _text.size()) {
+                return true;
+            }
+            char c = _text[_pos++];
+            if (c == '\n') {
+                ++_line;
+                return true;
+            } else if (c == '\r') {
+                if (_pos < _text.size() && _text[_pos] == '\n') {
+                    ++_pos;
+                }
+                ++_line;
+                return true;
+            }
+        }
+    }
+
+    // Line the last row started on.
+    int line() const { return _rowLine; }
+
+   private:
+    std::string field() {
+        std::string out;
+        if (_pos == _text.size() || _text[_pos] != '"') {
+            size_t end = _text.find_first_of(",\r\n", _pos);
+            end = end == std::string::npos ? _text.size() : end;
+            out.assign(_text, _pos, end - _pos);
+            _pos = end;
+            return out;
+        }
+
+        int start = _line;
+        ++_pos;
+        while (true) {
+            size_t quote = _text.find('"', _pos);
+            if (quote == std::string::npos) {
+                throw std::invalid_argument("line " + std::to_string(start) +
+                                            ": unterminated quoted field");
+            }
+            _line += std::count(_text.begin() + _pos, _text.begin() + quote, '\n');
+            out.append(_text, _pos, quote - _pos);
+            _pos = quote + 1;
+            if (_pos < _text.size() && _text[_pos] == '"') {
+                out += '"';
+                ++_pos;
+            } else {
+                break;
+            }
+        }
+        if (_pos < _text.size() && _text[_pos] != ',' && _text[_pos] != '\r' &&
+            _text[_pos] != '\n') {
+            throw std::invalid_argument("line " + std::to_string(_line) +
+                                        ": text after a quoted field");
+        }
+        return out;
+    }
+
+    const std::string& _text;
+    size_t             _pos;
+    int                _line;
+    int                _rowLine;
+};
+
+struct Row {
+    int         id;
+    std::string name;
+    int         fields[FIELD_COUNT];
+};
+
+int parseInt(const std::string& text, int line, const char* column, int min) {
+    errno = 0;
+    char* end;
+    long  value = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno != 0 || value < min ||
+        value > std::numeric_limits<int>::max()) {
+        throw std::invalid_argument("line " + std::to_string(line) + ": " + column +
+                                    ": expected an integer of at least " +
+                                    std::to_string(min) + ", got \"" + text + "\"");
+    }
+    return static_cast<int>(value);
+}
+
+std::vector<Row> readCsv(const std::string& text) {
+    CsvReader                reader(text);
+    std::vector<std::string> fields;
+    if (!reader.next(fields)) {
+        throw std::invalid_argument("no header row");
+    }
+
+    auto column = [&](const char* name, bool required) {
+        auto it = std::find(fields.begin(), fields.end(), name);
+        if (it == fields.end() && required) {
+            throw std::invalid_argument(std::string("no \"") + name + "\" column");
+        }
+        return it == fields.end() ? -1 : static_cast<int>(it - fields.begin());
+    };
+    int idColumn = column("id", true);
+    int nameColumn = column("name", true);
+    int recipeColumns[FIELD_COUNT];
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+        recipeColumns[i] = column(RECIPE_COLUMNS[i].name, RECIPE_COLUMNS[i].required);
+    }
+    size_t columnCount = fields.size();
+
+    std::vector<Row> rows;
+    while (reader.next(fields)) {
+        int line = reader.line();
+        if (fields.size() != columnCount) {
+            throw std::invalid_argument("line " + std::to_string(line) + ": expected " +
+                                        std::to_string(columnCount) + " fields, got " +
+                                        std::to_string(fields.size()));
+        }
+
+        Row& row = rows.emplace_back();
+        row.id = parseInt(fields[idColumn], line, "id", 0);
+        if (row.id > MAX_ID) {
+            throw std::invalid_argument("line " + std::to_string(line) +
+                                        ": id: must be at most " +
+                                        std::to_string(MAX_ID));
+        }
+        row.name = std::move(fields[nameColumn]);
+        if (row.name.empty()) {
+            throw std::invalid_argument("line " + std::to_string(line) + ": empty name");
+        }
+        for (int i = 0; i < FIELD_COUNT; ++i) {
+            const char* name = RECIPE_COLUMNS[i].name;
+            // The dividers are divided by, everything else may be 0.
+            int min = strcmp(name, "progressDivider") == 0 ||
+                              strcmp(name, "qualityDivider") == 0
+                          ? 1
+                          : 0;
+            row.fields[i] = recipeColumns[i] < 0
+                                ? 0
+                                : parseInt(fields[recipeColumns[i]], line, name, min);
+        }
+    }
+    return rows;
+}
+
+template <typename T>
+void append(std::vector<char>& out, const T* data, size_t count) {
+    const char* bytes = reinterpret_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+}  // namespace
+
+int RecipeDatabase::build(const std::string& csvPath, const std::string& dbPath) {
+    std::ifstream csv(csvPath, std::ios::binary);
+    if (!csv) {
+        throw std::runtime_error("Could not read " + csvPath);
+    }
+    std::string      text((std::istreambuf_iterator<char>(csv)),
+                          std::istreambuf_iterator<char>());
+    std::vector<Row> rows;
+    try {
+        rows = readCsv(text);
+    } catch (const std::invalid_argument& e) {
+        throw std::invalid_argument(csvPath + ": " + e.what());
+    }
+
+    uint32_t count = rows.size();
+    uint32_t maxId = 0;
+    for (const Row& row : rows) {
+        maxId = std::max(maxId, static_cast<uint32_t>(row.id));
+    }
+    // At most half full, so that misses end their probe early.
+    uint32_t nameCapacity = 16;
+    while (nameCapacity < 2 * count) {
+        nameCapacity *= 2;
+    }
+
+    std::vector<uint32_t> ids(count);
+    std::vector<uint32_t> nameOffsets(count + 1);
+    std::vector<uint32_t> idSlots(maxId + 1, EMPTY);
+    std::vector<uint32_t> nameSlots(nameCapacity, EMPTY);
+    std::string           strings;
+    for (uint32_t i = 0; i < count; ++i) {
+        const Row& row = rows[i];
+        if (idSlots[row.id] != EMPTY) {
+            throw std::invalid_argument(csvPath + ": duplicate id " +
+                                        std::to_string(row.id));
+        }
+        idSlots[row.id] = i;
+        ids[i] = row.id;
+        nameOffsets[i] = strings.size();
+        strings += row.name;
+
+        uint32_t slot = hashName(row.name) & (nameCapacity - 1);
+        while (nameSlots[slot] != EMPTY) {
+            if (sameName(rows[nameSlots[slot]].name, row.name)) {
+                break;
+            }
+            slot = (slot + 1) & (nameCapacity - 1);
+        }
+        if (nameSlots[slot] == EMPTY) {
+            nameSlots[slot] = i;
+        }
+    }
+    nameOffsets[count] = strings.size();
+    if (strings.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument(csvPath + ": too many names");
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = count;
+    header.maxId = maxId;
+    header.nameCapacity = nameCapacity;
+    header.stringsSize = strings.size();
+
+    std::vector<char> out;
+    out.reserve(fileSize(header));
+    append(out, &header, 1);
+    for (const Row& row : rows) {
+        append(out, row.fields, FIELD_COUNT);
+    }
+    append(out, ids.data(), ids.size());
+    append(out, nameOffsets.data(), nameOffsets.size());
+    append(out, idSlots.data(), idSlots.size());
+    append(out, nameSlots.data(), nameSlots.size());
+    append(out, strings.data(), strings.size());
+
+    // Written next to the target and renamed over it, so that processes that
+    // have the old database mapped keep reading a whole file.
+    std::string   tmpPath = dbPath + ".tmp";
+    std::ofstream db(tmpPath, std::ios::binary | std::ios::trunc);
+    db.write(out.data(), out.size());
+    db.close();
+    if (!db || rename(tmpPath.c_str(), dbPath.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        throw std::runtime_error("Could not write " + dbPath);
+    }
+    return count;
+}
+
+size_t RecipeDatabase::fileSize(const Header& header) {
+    return sizeof(Header) + size_t(header.count) * sizeof(Recipe) +
+           (2 * size_t(header.count) + 1 + size_t(header.maxId) + 1 +
+            header.nameCapacity) *
+               sizeof(uint32_t) +
+           header.stringsSize;
+}
+
+RecipeDatabase::RecipeDatabase(const std::string& path)
+    : _path(path), _memory(MAP_FAILED), _mappedSize(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open recipe database " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error(path + " is not a recipe database.");
+    }
+    _mappedSize = st.st_size;
+    _memory = mmap(nullptr, _mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_memory == MAP_FAILED) {
+        throw std::runtime_error("Could not map recipe database " + path);
+    }
+
+    _header = static_cast<const Header*>(_memory);
+    if (std::memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        _header->version != VERSION || _header->maxId > MAX_ID ||
+        _header->nameCapacity == 0 ||
+        (_header->nameCapacity & (_header->nameCapacity - 1)) != 0 ||
+        _header->stringsSize > std::numeric_limits<uint32_t>::max() ||
+        fileSize(*_header) != _mappedSize) {
+        munmap(_memory, _mappedSize);
+        throw std::runtime_error(path + " is not a recipe database of this version.");
+    }
+
+    _recipes = reinterpret_cast<const Recipe*>(_header + 1);
+    _ids = reinterpret_cast<const uint32_t*>(_recipes + _header->count);
+    _nameOffsets = _ids + _header->count;
+    _idSlots = _nameOffsets + _header->count + 1;
+    _nameSlots = _idSlots + _header->maxId + 1;
+    _strings = reinterpret_cast<const char*>(_nameSlots + _header->nameCapacity);
+}
+
+RecipeDatabase::~RecipeDatabase() { munmap(_memory, _mappedSize); }
+
+int RecipeDatabase::size() const { return _header->count; }
+
+// Slots and offsets are checked as they are used rather than all at once when
+// opening, so that a damaged file gives wrong answers but never reads outside
+// the mapping.
+
+const Recipe* RecipeDatabase::findById(int id) const {
+    if (id < 0 || uint32_t(id) > _header->maxId) {
+        return nullptr;
+    }
+    uint32_t index = _idSlots[id];
+    return index < _header->count ? &_recipes[index] : nullptr;
+}
+
+const Recipe* RecipeDatabase::findByName(std::string_view name) const {
+    uint32_t mask = _header->nameCapacity - 1;
+    uint32_t slot = hashName(name) & mask;
+    for (uint32_t probes = 0; probes <= mask; ++probes) {
+        uint32_t index = _nameSlots[slot];
+        if (index >= _header->count) {
+            return nullptr;
+        }
+        if (sameName(this->name(index), name)) {
+            return &_recipes[index];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+const Recipe& RecipeDatabase::recipe(int index) const { return _recipes[index]; }
+
+int RecipeDatabase::id(int index) const { return _ids[index]; }
+
+std::string_view RecipeDatabase::name(int index) const {
+    uint32_t begin = _nameOffsets[index];
+    uint32_t end = _nameOffsets[index + 1];
+    if (begin > end || end > _header->stringsSize) {
+        return {};
+    }
+    return std::string_view(_strings + begin, end - begin);
+}
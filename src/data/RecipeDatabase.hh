@@ -0,0 +1,75 @@
+#ifndef DATA_RECIPEDATABASE_HH_
+#define DATA_RECIPEDATABASE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "../model/Recipe.hh"
+
+// Every recipe of the game, by id or by name.
+//
+// The database is a binary file that is memory-mapped as it is: opening it only
+// checks its header, and lookups return references into the mapping instead of
+// copies. Ids are looked up in a table with a slot per id, names in an
+// open-addressing hash table. The file is made once from a CSV export with
+// build(), in the byte order of the machine that reads it.
+class RecipeDatabase {
+   public:
+    // Converts a CSV file with a header row into a database at dbPath and returns
+    // the number of recipes. Columns are found by their header: "id", "name" and
+    // the fields of Recipe under their own names. startQuality and safetyMargin
+    // may be left out and are 0 then, unknown columns are skipped. Throws
+    // std::invalid_argument naming the line of a bad row, std::runtime_error if
+    // a file can't be read or written.
+    static int build(const std::string& csvPath, const std::string& dbPath);
+
+    // Throws std::runtime_error if the file can't be mapped or isn't a database.
+    explicit RecipeDatabase(const std::string& path);
+    ~RecipeDatabase();
+
+    RecipeDatabase(const RecipeDatabase&) = delete;
+    RecipeDatabase& operator=(const RecipeDatabase&) = delete;
+
+    int size() const;
+
+    // nullptr if there is no such recipe. Names are compared ignoring ASCII
+    // case. Of several recipes with the same name, the first in the CSV wins.
+    const Recipe* findById(int id) const;
+    const Recipe* findByName(std::string_view name) const;
+
+    // The recipes in CSV order, for going through all of them.
+    const Recipe&    recipe(int index) const;
+    int              id(int index) const;
+    std::string_view name(int index) const;
+
+   private:
+    // The sections follow the header in this order: count recipes, count ids,
+    // count + 1 name offsets, maxId + 1 id slots, nameCapacity name slots and
+    // stringsSize bytes of names. Slots hold the index of a recipe or EMPTY.
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t count;
+        uint32_t maxId;
+        uint32_t nameCapacity;
+        uint64_t stringsSize;
+    };
+
+    static size_t fileSize(const Header& header);
+
+    std::string _path;
+    void*       _memory;
+    size_t      _mappedSize;
+
+    const Header*   _header;
+    const Recipe*   _recipes;
+    const uint32_t* _ids;
+    const uint32_t* _nameOffsets;
+    const uint32_t* _idSlots;
+    const uint32_t* _nameSlots;
+    const char*     _strings;
+};
+
+#endif  // DATA_RECIPEDATABASE_HH_
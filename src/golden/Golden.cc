@@ -0,0 +1,330 @@
+// Golden-output regression checks of the simulators.
+//
+// --record plays every job of a job file with its own sequence and a number of
+// random ones, and writes what SimSynth and MonteCarloSim make of them, state
+// by state, as a golden file. --check replays a golden file and lists every
+// state that comes out different, so that changes meant to keep the crafting
+// math as it is can be checked against the build that recorded it.
+//
+// Doubles are compared to the last bit, so the tool and the simulators it
+// links are built without fast math in every configuration. The check of
+// golden/simulator.json runs as a test.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../actions/ActionTable.hh"
+#include "../config/JobFile.hh"
+#include "../config/Json.hh"
+#include "../model/State.hh"
+#include "../model/Synth.hh"
+#include "../solver/ConditionalActionHandling.hh"
+#include "../solver/montecarlo/MonteCarloSim.hh"
+#include "../solver/simulation/SimSynth.hh"
+
+namespace {
+
+constexpr int VERSION = 1;
+
+constexpr const char* HANDLINGS[] = {"reposition", "skipUnusable", "ignoreUnusable"};
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(path + ": could not open the file");
+    }
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+// What a case is played with: the job's synth and its start state.
+struct Craft {
+    explicit Craft(const BatchJob& job)
+        : settings(job.settings),
+          synth(settings.crafter, settings.recipe, settings.maxTrickUses,
+                settings.reliabilityPercent / 100.0, settings.useConditions,
+                settings.maxLength, settings.solver),
+          startState(synth) {}
+
+    SolverSettings settings;
+    Synth          synth;
+    State          startState;
+};
+
+struct Case {
+    int                       job;
+    ActionSequence            sequence;
+    unsigned                  seed;
+    ConditionalActionHandling handling;
+
+    // One line per state, see describe().
+    std::vector<std::string> trace;
+    std::string              final;
+    std::vector<std::string> monteCarlo;
+};
+
+// Everything a step can change, doubles to the last bit.
+std::string describe(const State& s) {
+    char line[512];
+    snprintf(line, sizeof(line),
+             "%d %s dur=%.17g cp=%.17g q=%.17g prog=%.17g waste=%.17g tricks=%d "
+             "rel=%d cond=%s combo=%d maxCp=%d",
+             s.step(), s.action() == NoAction ? "-" : ALL_ACTIONS[s.action()].shortName,
+             s.durability(), s.cp(), s.quality(), s.progress(), s.wastedActions(),
+             s.trickUses(), s.reliability(), condition2str(s.condition()),
+             s.touchComboStep(), s.bonusMaxCp());
+
+    std::string text = line;
+    for (int i = 0; i < ACTION_COUNT; ++i) {
+        const auto& up = s.effects().countUps[i];
+        const auto& down = s.effects().countDowns[i];
+        if (up) {
+            snprintf(line, sizeof(line), " %s+%.17g", ALL_ACTIONS[i].shortName, *up);
+            text += line;
+        }
+        if (down) {
+            snprintf(line, sizeof(line), " %s-%d", ALL_ACTIONS[i].shortName, *down);
+            text += line;
+        }
+    }
+    return text;
+}
+
+// Fills in what the simulators make of a case.
+void play(Case& c, const Craft& craft) {
+    SimSynth simSynth;
+
+    c.trace.clear();
+    State s(craft.startState);
+    for (ActionId actionId : c.sequence) {
+        simSynth.step(s, actionId, false);
+        c.trace.push_back(describe(s));
+    }
+    c.final =
+        describe(simSynth.execute(c.sequence, craft.startState, false, false, false));
+
+    MonteCarloSim monteCarloSim;
+    monteCarloSim.seed(c.seed);
+    c.monteCarlo.clear();
+    for (const State& state : monteCarloSim.sequence(c.sequence, craft.startState, false,
+                                                     c.handling, false, false)) {
+        c.monteCarlo.push_back(describe(state));
+    }
+}
+
+std::string quoteLines(const std::vector<std::string>& lines, const char* indent) {
+    std::string text = "[";
+    for (int i = 0; i < lines.size(); ++i) {
+        text += i > 0 ? ",\n" : "\n";
+        text += indent + quoteJson(lines[i]);
+    }
+    return text + "]";
+}
+
+int record(const char* jobsPath, int nRandom, unsigned seed) {
+    const std::string     jobsText = readFile(jobsPath);
+    std::vector<BatchJob> jobs = parseJobs(jobsText, jobsPath, nullptr);
+
+    // Random sequences of 2 to 30 of the crafter's actions.
+    std::mt19937      rng(seed);
+    std::vector<Case> cases;
+    for (int j = 0; j < jobs.size(); ++j) {
+        const std::vector<ActionId>& actions = jobs[j].settings.crafter.actions;
+        std::vector<ActionSequence>  sequences;
+        if (!jobs[j].settings.sequence.empty()) {
+            sequences.push_back(jobs[j].settings.sequence);
+        }
+        for (int i = 0; i < nRandom; ++i) {
+            ActionSequence& sequence = sequences.emplace_back(2 + rng() % 29);
+            for (ActionId& actionId : sequence) {
+                actionId = actions[rng() % actions.size()];
+            }
+        }
+
+        for (ActionSequence& sequence : sequences) {
+            int n = cases.size();
+            cases.push_back({.job = j,
+                             .sequence = std::move(sequence),
+                             .seed = seed + n,
+                             .handling = static_cast<ConditionalActionHandling>(n % 3)});
+        }
+    }
+
+    std::vector<std::unique_ptr<Craft>> crafts;
+    for (const BatchJob& job : jobs) {
+        crafts.push_back(std::make_unique<Craft>(job));
+    }
+    for (Case& c : cases) {
+        play(c, *crafts[c.job]);
+    }
+
+    printf("{\n\"version\": %d,\n\"jobs\": %s,\n\"cases\": [", VERSION, jobsText.c_str());
+    for (int i = 0; i < cases.size(); ++i) {
+        const Case& c = cases[i];
+        printf("%s\n{\"job\": %d, \"seed\": %u, \"handling\": \"%s\",\n \"sequence\": [",
+               i > 0 ? "," : "", c.job, c.seed, HANDLINGS[c.handling]);
+        for (int k = 0; k < c.sequence.size(); ++k) {
+            printf("%s\"%s\"", k > 0 ? ", " : "", ALL_ACTIONS[c.sequence[k]].shortName);
+        }
+        printf("],\n \"trace\": %s,\n \"final\": %s,\n \"monteCarlo\": %s}",
+               quoteLines(c.trace, "  ").c_str(), quoteJson(c.final).c_str(),
+               quoteLines(c.monteCarlo, "  ").c_str());
+    }
+    printf("\n]\n}\n");
+    return 0;
+}
+
+const JsonValue& member(const JsonValue& object, const char* key,
+                        JsonValue::Type type) {
+    const JsonValue* value = object.find(key);
+    if (value == nullptr || value->type != type) {
+        throw std::invalid_argument("line " + std::to_string(object.line) +
+                                    ": expected " + jsonType2str(type) + " \"" + key +
+                                    "\"");
+    }
+    return *value;
+}
+
+std::vector<std::string> readLines(const JsonValue& array) {
+    std::vector<std::string> lines;
+    for (const JsonValue& line : array.array) {
+        lines.push_back(line.string);
+    }
+    return lines;
+}
+
+// Prints where the lines first differ. Returns whether they are the same.
+bool compare(const char* what, int caseIndex, const std::vector<std::string>& expected,
+             const std::vector<std::string>& actual) {
+    for (int i = 0; i < std::max(expected.size(), actual.size()); ++i) {
+        const char* e = i < expected.size() ? expected[i].c_str() : "(none)";
+        const char* a = i < actual.size() ? actual[i].c_str() : "(none)";
+        if (strcmp(e, a) != 0) {
+            printf("case %d, %s, state %d:\n  expected %s\n  got      %s\n", caseIndex,
+                   what, i + 1, e, a);
+            return false;
+        }
+    }
+    return true;
+}
+
+int check(const char* goldenPath) {
+    JsonValue document = parseJson(readFile(goldenPath));
+    if (document.type != JsonValue::Object ||
+        member(document, "version", JsonValue::Number).number != VERSION) {
+        throw std::invalid_argument("not a golden file of this version");
+    }
+
+    const JsonValue* jobsValue = document.find("jobs");
+    if (jobsValue == nullptr) {
+        throw std::invalid_argument("missing \"jobs\"");
+    }
+    std::vector<std::unique_ptr<Craft>> crafts;
+    if (jobsValue->type == JsonValue::Array) {
+        for (int i = 0; i < jobsValue->array.size(); ++i) {
+            std::string path = "jobs[" + std::to_string(i) + "]";
+            crafts.push_back(
+                std::make_unique<Craft>(parseJob(jobsValue->array[i], path, nullptr)));
+        }
+    } else {
+        crafts.push_back(std::make_unique<Craft>(parseJob(*jobsValue, "jobs", nullptr)));
+    }
+
+    const JsonValue& cases = member(document, "cases", JsonValue::Array);
+    int              failed = 0;
+    for (int i = 0; i < cases.array.size(); ++i) {
+        const JsonValue& value = cases.array[i];
+
+        Case c{.job = static_cast<int>(member(value, "job", JsonValue::Number).number),
+               .seed = static_cast<unsigned>(
+                   member(value, "seed", JsonValue::Number).number)};
+        const std::string& handling = member(value, "handling", JsonValue::String).string;
+        c.handling = static_cast<ConditionalActionHandling>(
+            std::find(std::begin(HANDLINGS), std::end(HANDLINGS), handling) -
+            std::begin(HANDLINGS));
+        const JsonValue& sequence = member(value, "sequence", JsonValue::Array);
+        for (const JsonValue& action : sequence.array) {
+            ActionId actionId = NoAction;
+            for (const Action& candidate : ALL_ACTIONS) {
+                if (action.string == candidate.shortName) {
+                    actionId = candidate.id;
+                }
+            }
+            c.sequence.push_back(actionId);
+        }
+        if (c.job < 0 || c.job >= crafts.size() || c.handling > IgnoreUnusable ||
+            std::count(c.sequence.begin(), c.sequence.end(), NoAction) > 0) {
+            throw std::invalid_argument("line " + std::to_string(value.line) +
+                                        ": bad case");
+        }
+
+        play(c, *crafts[c.job]);
+        bool same =
+            compare("trace", i, readLines(member(value, "trace", JsonValue::Array)),
+                    c.trace) &&
+            compare("final", i, {member(value, "final", JsonValue::String).string},
+                    {c.final}) &&
+            compare("monteCarlo", i,
+                    readLines(member(value, "monteCarlo", JsonValue::Array)),
+                    c.monteCarlo);
+        failed += !same;
+    }
+
+    printf("%d of %zu cases differ.\n", failed, cases.array.size());
+    return failed > 0 ? 1 : 0;
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "usage: %s --record jobs.json [--random N] [--seed S] > golden.json\n"
+            "       %s --check golden.json\n"
+            "\n"
+            "Records what the simulators make of each job's sequence and of N random\n"
+            "ones (16 by default), or replays a recording and lists the differences.\n",
+            program, program);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* recordPath = nullptr;
+    const char* checkPath = nullptr;
+    int         nRandom = 16;
+    unsigned    seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--record") == 0) {
+            recordPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--check") == 0) {
+            checkPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--random") == 0) {
+            nRandom = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoul(argv[i + 1], nullptr, 10);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((recordPath == nullptr) == (checkPath == nullptr) || argc % 2 == 0 ||
+        nRandom < 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        return recordPath != nullptr ? record(recordPath, nRandom, seed)
+                                     : check(checkPath);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+}
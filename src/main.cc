@@ -1,84 +1,388 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "actions/ActionTable.hh"
+#include "config/JobFile.hh"
+#include "daemon/Daemon.hh"
+#include "data/RecipeDatabase.hh"
 #include "solver/Solver.hh"
 #include "solver/SolverSettings.hh"
+#include "solver/batch/BatchSolver.hh"
+#include "solver/library/MacroLibrary.hh"
+#include "solver/parallel/ThreadPool.hh"
+#include "solver/profile/Profiler.hh"
+#include "solver/profile/Trace.hh"
+#include "solver/sweep/StatSweep.hh"
+#include "solver/validate/MacroValidator.hh"
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [options] job.json...\n"
+            "       %s --daemon [--socket FILE] [--queue N] [options]\n"
+            "       %s --sweep sweep.json [options]\n"
+            "       %s --validate validate.json [options]\n"
+            "       %s --library library.json [options]\n"
+            "       %s --build-recipes recipes.csv FILE\n"
+            "\n"
+            "Solves every job in the given job files. A single job is solved with\n"
+            "its full output, several jobs are solved side by side on one thread\n"
+            "pool and reported as they finish. As a daemon, solves the requests\n"
+            "given as JSON lines on stdin or on a Unix socket until stopped. A\n"
+            "sweep finds the least crafter stats that reach max quality. Validating\n"
+            "checks every macro against every crafter and prints a CSV line each.\n"
+            "A macro library adds macros to a store of known ones and looks up the\n"
+            "best one each crafter can use.\n"
+            "\n"
+            "  --threads N  threads to use, 0 for one per hardware thread\n"
+            "  --jobs N     jobs to solve at once, 0 for one per thread\n"
+            "  --recipes FILE\n"
+            "               recipe database, for jobs naming their recipe by id or name\n"
+            "  --cache FILE solution cache for jobs that don't name one, and for all\n"
+            "               requests to the daemon\n"
+            "  --queue N    requests the daemon keeps waiting before rejecting more\n"
+            "  --trace FILE writes a timeline of the run, for chrome://tracing or\n"
+            "               Perfetto, when done\n"
+            "  --build-recipes\n"
+            "               converts a CSV export of the game's recipes to a database\n",
+            program, program, program, program, program, program);
+}
+
+static bool parseCount(const char* text, int& count) {
+    if (text == nullptr) {
+        return false;
+    }
+    char* end;
+    long  value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < 0 || value > 4096) {
+        return false;
+    }
+    count = static_cast<int>(value);
+    return true;
+}
+
+static void printResult(const BatchResult& result, int done, int total) {
+    if (!result.error.empty()) {
+        printf("[%d/%d] %s: failed: %s\n", done, total, result.name.c_str(),
+               result.error.c_str());
+        return;
+    }
+
+    printf("[%d/%d] %s: fitness %.1f, %.1f %% success, quality %.0f, %zu steps, %.1f s\n",
+           done, total, result.name.c_str(), result.best.fitness.fitness,
+           result.stats.successPercent, result.stats.avgStats.quality,
+           result.best.sequence.size(), result.seconds);
+    printf("   ");
+    for (ActionId id : result.best.sequence) {
+        printf(" %s", ALL_ACTIONS[id].shortName);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static int buildRecipes(const char* csvPath, const char* dbPath) {
+    try {
+        int count = RecipeDatabase::build(csvPath, dbPath);
+        printf("Wrote %d recipes to %s\n", count, dbPath);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+static int serve(int threads, int maxJobs, int maxQueued, const char* socketPath,
+                 const char* recipesPath, const char* cachePath) {
+    try {
+        std::unique_ptr<RecipeDatabase> recipes;
+        if (recipesPath != nullptr) {
+            recipes = std::make_unique<RecipeDatabase>(recipesPath);
+        }
+
+        ThreadPool pool(threads < 0 ? 0 : threads);
+        Daemon     daemon(pool,
+                          {
+                              .maxActive = maxJobs,
+                              .maxQueued = maxQueued,
+                              .cachePath = cachePath ? cachePath : "",
+                          },
+                          recipes.get());
+        if (socketPath != nullptr) {
+            daemon.listen(socketPath);
+        } else {
+            daemon.serve(STDIN_FILENO, STDOUT_FILENO);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+static void printPoint(const SweepPoint& point) {
+    printf("  %5d %5d %4d  %-10s fitness %.1f, %zu steps, %.1f s\n", point.stats[0],
+           point.stats[1], point.stats[2], point.sufficient ? "max quality" : "short",
+           point.best.fitness.fitness, point.best.sequence.size(), point.seconds);
+    fflush(stdout);
+}
+
+static int sweep(int threads, const char* sweepPath, const char* recipesPath,
+                 const char* cachePath) {
+    try {
+        std::unique_ptr<RecipeDatabase> recipes;
+        if (recipesPath != nullptr) {
+            recipes = std::make_unique<RecipeDatabase>(recipesPath);
+        }
+        SweepJob        sweepJob = loadSweepFile(sweepPath, recipes.get());
+        SolverSettings& settings = sweepJob.job.settings;
+        if (cachePath != nullptr && settings.cache.path.empty()) {
+            settings.cache.path = cachePath;
+        }
+
+        ThreadPool pool(threads < 0 ? 0 : threads);
+        StatSweep  statSweep(pool, sweepJob.sweep);
+        printf("Solved points (craftsmanship, control, CP):\n");
+        std::vector<SweepPoint> frontier = statSweep.run(settings, printPoint);
+
+        printf("\nLeast stats reaching max quality:\n");
+        for (const SweepPoint& point : frontier) {
+            printPoint(point);
+        }
+        if (frontier.empty()) {
+            printf("  none\n");
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+static int validate(int threads, const char* validationPath, const char* recipesPath) {
+    try {
+        std::unique_ptr<RecipeDatabase> recipes;
+        if (recipesPath != nullptr) {
+            recipes = std::make_unique<RecipeDatabase>(recipesPath);
+        }
+        ValidationJob validation = loadValidationFile(validationPath, recipes.get());
+
+        ThreadPool     pool(threads < 0 ? 0 : threads);
+        MacroValidator validator(pool, validation.job.settings, validation.crafters,
+                                 validation.validation);
+        std::vector<MacroCheck> checks = validator.validate(validation.macros);
+
+        const int nCrafters = validation.crafters.size();
+        printf("macro,crafter,feasible,quality,successPercent\n");
+        for (int i = 0; i < checks.size(); ++i) {
+            const MacroCheck& check = checks[i];
+            printf("%d,%d,%d,%.0f,%.2f\n", i / nCrafters, i % nCrafters, check.feasible,
+                   check.quality, check.successPercent);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+static int library(int threads, const char* libraryPath, const char* recipesPath) {
+    try {
+        std::unique_ptr<RecipeDatabase> recipes;
+        if (recipesPath != nullptr) {
+            recipes = std::make_unique<RecipeDatabase>(recipesPath);
+        }
+        LibraryJob   job = loadLibraryFile(libraryPath, recipes.get());
+        MacroLibrary library(job.job.settings, job.targetQuality);
+        if (!job.path.empty() && access(job.path.c_str(), F_OK) == 0) {
+            library.load(job.path);
+        }
+        if (!job.macros.empty()) {
+            ThreadPool pool(threads < 0 ? 0 : threads);
+            int        added = library.add(pool, job.macros);
+            printf("Kept %d of %zu macros, %d in the library.\n", added,
+                   job.macros.size(), library.size());
+            if (!job.path.empty()) {
+                library.save(job.path);
+            }
+        }
+
+        for (int i = 0; i < job.crafters.size(); ++i) {
+            const Crafter&      crafter = job.crafters[i];
+            const LibraryEntry* best = library.best(crafter);
+            printf("crafter %d (%d/%d/%d): ", i, crafter.craftsmanship, crafter.control,
+                   crafter.craftingPoints);
+            if (best == nullptr) {
+                printf("no macro\n");
+                continue;
+            }
+            printf("needs %d/%d/%d, at most %d craftsmanship\n   ", best->minStats[0],
+                   best->minStats[1], best->minStats[2], best->maxCraftsmanship);
+            for (ActionId actionId : best->sequence) {
+                printf(" %s", ALL_ACTIONS[actionId].shortName);
+            }
+            printf("\n");
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--build-recipes") == 0) {
+        if (argc != 4) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return buildRecipes(argv[2], argv[3]);
+    }
+
+    int                      threads = -1;
+    int                      maxJobs = 0;
+    int                      maxQueued = 64;
+    bool                     daemon = false;
+    const char*              socketPath = nullptr;
+    const char*              recipesPath = nullptr;
+    const char*              cachePath = nullptr;
+    const char*              sweepPath = nullptr;
+    const char*              validationPath = nullptr;
+    const char*              libraryPath = nullptr;
+    const char*              tracePath = nullptr;
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (strcmp(arg, "--daemon") == 0) {
+            daemon = true;
+            continue;
+        } else if (arg[0] != '-' || arg[1] != '-') {
+            paths.push_back(arg);
+            continue;
+        }
+
+        bool ok = value != nullptr;
+        if (strcmp(arg, "--threads") == 0) {
+            ok = parseCount(value, threads);
+        } else if (strcmp(arg, "--jobs") == 0) {
+            ok = parseCount(value, maxJobs);
+        } else if (strcmp(arg, "--queue") == 0) {
+            ok = parseCount(value, maxQueued);
+        } else if (strcmp(arg, "--socket") == 0) {
+            socketPath = value;
+        } else if (strcmp(arg, "--recipes") == 0) {
+            recipesPath = value;
+        } else if (strcmp(arg, "--cache") == 0) {
+            cachePath = value;
+        } else if (strcmp(arg, "--sweep") == 0) {
+            sweepPath = value;
+        } else if (strcmp(arg, "--validate") == 0) {
+            validationPath = value;
+        } else if (strcmp(arg, "--library") == 0) {
+            libraryPath = value;
+        } else if (strcmp(arg, "--trace") == 0) {
+            tracePath = value;
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!ok) {
+            fprintf(stderr, "bad or missing value for %s\n", arg);
+            return 1;
+        }
+        ++i;
+    }
+    int  modes = daemon + (sweepPath != nullptr) + (validationPath != nullptr) +
+                (libraryPath != nullptr);
+    bool needsPaths = modes == 0;
+    if (needsPaths == paths.empty() || modes > 1 || (socketPath != nullptr && !daemon)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Written on the way out, after everything traced has finished.
+    TraceSession trace(tracePath != nullptr ? tracePath : "");
+
+    if (sweepPath != nullptr) {
+        return sweep(threads, sweepPath, recipesPath, cachePath);
+    }
+    if (libraryPath != nullptr) {
+        return library(threads, libraryPath, recipesPath);
+    }
+    if (validationPath != nullptr) {
+        return validate(threads, validationPath, recipesPath);
+    }
+    if (daemon) {
+        return serve(threads, maxJobs, maxQueued, socketPath, recipesPath, cachePath);
+    }
+
+    // Only needed while loading: jobs hold copies of their recipes.
+    std::unique_ptr<RecipeDatabase> recipes;
+    std::vector<BatchJob>           jobs;
+    try {
+        if (recipesPath != nullptr) {
+            recipes = std::make_unique<RecipeDatabase>(recipesPath);
+        }
+        for (const char* path : paths) {
+            // BatchJob is not assignable, so no range insert.
+            for (BatchJob& job : loadJobFile(path, recipes.get())) {
+                if (cachePath != nullptr && job.settings.cache.path.empty()) {
+                    job.settings.cache.path = cachePath;
+                }
+                jobs.push_back(std::move(job));
+            }
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (jobs.empty()) {
+        fprintf(stderr, "no jobs given\n");
+        return 1;
+    }
 
-int main() {
-    // clang-format off
-    SolverSettings settings{
-        .recipe{
-            /*
-            // Rarefied Sykon Bavarois
-            .baseLevel = 90,
-            .level = 560,
-            .difficulty = 3500,
-            .durability = 80,
-            .startQuality = 0,
-            .safetyMargin = 0,
-            .maxQuality = 7200,
-            .suggestedCraftsmanship = 2805,
-            .suggestedControl = 2635,
-            .progressDivider = 130,
-            .progressModifier = 90,
-            .qualityDivider = 115,
-            .qualityModifier = 80,
-            .stars = 0,*/
-            // Baked Eggplant
-            .baseLevel = 90,
-            .level = 640,
-            .difficulty = 6600,
-            .durability = 70,
-            .startQuality = 0,
-            .safetyMargin = 0,
-            .maxQuality = 14040,
-            .suggestedCraftsmanship = 3700,
-            .suggestedControl = 3280,
-            .progressDivider = 130,
-            .progressModifier = 80,
-            .qualityDivider = 115,
-            .qualityModifier = 70,
-            .stars = 4,
-        },
-        .crafter{
-            .cls = Culinarian,
-            .level = 90,
-            .craftsmanship = 4041,
-            .control = 4043,
-            .craftingPoints = 611,
-            .actions{
-                MuscleMemory, Reflect, TrainedEye,
-                BasicSynthesis2, CarefulSynthesis2, Groundwork2, PrudentSynthesis,
-                DelicateSynthesis,
-                FocusedSynthesisCombo, FocusedTouchCombo, StandardTouchCombo, AdvancedTouchCombo,
-                BasicTouch, StandardTouch, AdvancedTouch, ByregotsBlessing, PrudentTouch, PreparatoryTouch, TrainedFinesse,
-                MastersMend, WasteNot, WasteNot2, Manipulation,
-                Veneration, GreatStrides, Innovation,
-                Observe,
-            },
-        },
-        .maxTrickUses = 0,
-        .reliabilityPercent = 100,
-        .maxLength = 0,
-        .useConditions = false,
-        .solver{
-            .population = 8000,
-            .generations = 2000,
-            .subPopulations = 30,
-            .maxStagnationCounter = 20,
-            .penaltyWeight = 10000,
-            .solveForCompletion = false,
-            .remainerCPFitnessValue = 10,
-            .remainerDuraFitnessValue = 100,
-            .probCrossover = 0.5,
-            .probMutation = 0.2,
-            .maxSubSeqLength = 4,
-        },
-        .sequence{},
-        .debug = false,
-    };
-    // clang-format on
-
-    Solver solver(settings);
-
-    solver.solve();
+    if (jobs.size() == 1) {
+        SolverSettings& settings = jobs[0].settings;
+        if (threads >= 0) {
+            settings.threads = threads;
+        }
+        try {
+            Solver solver(settings);
+            solver.solve();
+        } catch (const std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+        return 0;
+    }
 
+    ThreadPool  pool(threads < 0 ? 0 : threads);
+    BatchSolver batch(pool, maxJobs);
+    int         done = 0;
+    int         failed = 0;
+    batch.run(jobs, [&](const BatchResult& result) {
+        printResult(result, ++done, static_cast<int>(jobs.size()));
+        failed += !result.error.empty();
+    });
+    if (PROFILING) {
+        // Solves in a batch are quiet, so their phases are only shown summed up.
+        printf("Time by phase, over all threads:\n%s",
+               Profiler::format(Profiler::processTotals()).c_str());
+    }
+    if (failed > 0) {
+        fprintf(stderr, "%d of %zu jobs failed\n", failed, jobs.size());
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -37,6 +37,33 @@ bool State::isGoodOrExcellent() const {
     return _condition == Good || _condition == Excellent;
 }
 
+StateKey State::key() const {
+    StateKey key;
+    key.progress = _progressState;
+    key.quality = _qualityState;
+    key.durability = _durabilityState;
+    key.cp = _cpState;
+    key.innerQuiet = _effects.countUps[InnerQuiet].value_or(-1.0);
+
+    for (int i = 0; i < KEYED_COUNTDOWNS.size(); ++i) {
+        key.countDowns[i] = _effects.countDowns[KEYED_COUNTDOWNS[i]].value_or(-1);
+    }
+
+    // Only these change what the next action does.
+    if (_action == Observe || _action == BasicTouch || _action == StandardTouch) {
+        key.comboAction = _action;
+    } else {
+        key.comboAction = NoAction;
+    }
+
+    key.touchComboStep = _touchComboStep;
+    key.trickUses = _trickUses;
+    key.reliability = _reliability;
+    key.condition = _condition;
+    key.firstStep = _step == 0;
+    return key;
+}
+
 void State::checkViolations(bool &progressOk, bool &cpOk, bool &durabilityOk,
                             bool &trickOk, bool &reliabilityOk) const {
     progressOk = cpOk = durabilityOk = trickOk = reliabilityOk = false;
@@ -7,6 +7,7 @@
 #include "../actions/ActionId.hh"
 #include "Condition.hh"
 #include "EffectTracker.hh"
+#include "StateKey.hh"
 
 class ConditionModel;
 class Synth;
@@ -39,14 +40,34 @@ class State {
 
     bool isGoodOrExcellent() const;
 
-   private:
+    StateKey key() const;
+
+    // Read-only views of the state, for code outside the simulators.
+    const Synth         &synthesis() const { return *synth; }
+    int                  step() const { return _step; }
+    ActionId             action() const { return _action; }
+    double               durability() const { return _durabilityState; }
+    double               cp() const { return _cpState; }
+    int                  bonusMaxCp() const { return _bonusMaxCp; }
+    double               quality() const { return _qualityState; }
+    double               progress() const { return _progressState; }
+    double               wastedActions() const { return _wastedActions; }
+    int                  trickUses() const { return _trickUses; }
+    int                  reliability() const { return _reliability; }
+    const EffectTracker &effects() const { return _effects; }
+    Condition            condition() const { return _condition; }
+    int                  touchComboStep() const { return _touchComboStep; }
+
     void checkViolations(bool &progressOk, bool &cpOk, bool &durabilityOk, bool &trickOk,
                          bool &reliabilityOk) const;
 
-    bool useConditionalAction(const ConditionModel &condition);
-
+    // The gains and costs of an action in this state, as a step works them out.
+    // Moves the combo and waste counters along as a step would.
     ModifiedState applyModifiers(const Action &action, const ConditionModel &condition);
 
+   private:
+    bool useConditionalAction(const ConditionModel &condition);
+
     void applySpecialActionEffects(const Action         &actionId,
                                    const ConditionModel &condition);
     void updateEffectCounters(const Action &actionId, const ConditionModel &condition,
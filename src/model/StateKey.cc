@@ -0,0 +1,67 @@
+#include "StateKey.hh"
+
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t mix(uint64_t h, uint64_t v) { return (h ^ v) * FNV_PRIME; }
+
+// Spreads the high bits of the FNV product back over the low bits.
+inline uint64_t finalize(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+inline uint64_t bits(double x) {
+    // -0.0 and 0.0 compare equal, so they must hash the same.
+    if (x == 0) {
+        return 0;
+    }
+    uint64_t v;
+    std::memcpy(&v, &x, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+bool StateKey::sameEffects(const StateKey& other) const {
+    return innerQuiet == other.innerQuiet && countDowns == other.countDowns &&
+           comboAction == other.comboAction && touchComboStep == other.touchComboStep &&
+           trickUses == other.trickUses && reliability == other.reliability &&
+           condition == other.condition && firstStep == other.firstStep;
+}
+
+size_t StateKey::effectsHash() const { return finalize(rawEffectsHash()); }
+
+uint64_t StateKey::rawEffectsHash() const {
+    uint64_t h = FNV_OFFSET;
+    for (int8_t c : countDowns) {
+        h = mix(h, static_cast<uint8_t>(c));
+    }
+    h = mix(h, bits(innerQuiet));
+    h = mix(h, comboAction);
+    h = mix(h, static_cast<uint8_t>(touchComboStep));
+    h = mix(h, static_cast<uint8_t>(trickUses));
+    h = mix(h, static_cast<uint8_t>(reliability));
+    h = mix(h, condition);
+    h = mix(h, firstStep);
+    return h;
+}
+
+bool StateKey::operator==(const StateKey& other) const {
+    return progress == other.progress && quality == other.quality &&
+           durability == other.durability && cp == other.cp && sameEffects(other);
+}
+
+size_t StateKey::hash() const {
+    uint64_t h = rawEffectsHash();
+    h = mix(h, bits(progress));
+    h = mix(h, bits(quality));
+    h = mix(h, bits(durability));
+    h = mix(h, bits(cp));
+    return finalize(h);
+}
@@ -0,0 +1,61 @@
+#ifndef MODEL_STATEKEY_HH_
+#define MODEL_STATEKEY_HH_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "../actions/ActionId.hh"
+#include "Condition.hh"
+
+// Effects that count down and therefore take part in a state's identity.
+constexpr std::array<ActionId, 7> KEYED_COUNTDOWNS{
+    Manipulation, WasteNot, WasteNot2, Veneration, Innovation, GreatStrides, MuscleMemory,
+};
+
+// Compact canonical identity of a State: its resources and everything that
+// decides how it can evolve from here. Sequences that reach the same state in
+// a different order (say Veneration then Innovation, or the reverse) have equal
+// keys. What it took to get there (wasted actions, step count) is not part of it.
+struct StateKey {
+    double progress;
+    double quality;
+    double durability;
+    double cp;
+    double innerQuiet;  // -1 when Inner Quiet is not active.
+
+    std::array<int8_t, KEYED_COUNTDOWNS.size()> countDowns;  // -1 when inactive.
+
+    ActionId  comboAction;  // Last action if it enables a combo, NoAction otherwise.
+    int8_t    touchComboStep;
+    int8_t    trickUses;
+    int8_t    reliability;
+    Condition condition;
+    bool      firstStep;
+
+    // Same effects, resources aside.
+    bool   sameEffects(const StateKey& other) const;
+    size_t effectsHash() const;
+
+    bool   operator==(const StateKey& other) const;
+    size_t hash() const;
+
+    struct Hash {
+        size_t operator()(const StateKey& key) const { return key.hash(); }
+    };
+
+    struct EffectsHash {
+        size_t operator()(const StateKey& key) const { return key.effectsHash(); }
+    };
+
+    struct EffectsEqual {
+        bool operator()(const StateKey& x, const StateKey& y) const {
+            return x.sameEffects(y);
+        }
+    };
+
+   private:
+    uint64_t rawEffectsHash() const;
+};
+
+#endif  // MODEL_STATEKEY_HH_
@@ -0,0 +1,84 @@
+#include "Diversity.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Pairs of sequences compared for the mean edit distance.
+constexpr int EDIT_DISTANCE_PAIRS = 64;
+
+// Least number of actions inserted, removed or replaced to turn x into y.
+int editDistance(const ActionSequence& x, const ActionSequence& y) {
+    std::vector<int> row(y.size() + 1);
+    std::iota(row.begin(), row.end(), 0);
+    for (int i = 1; i <= x.size(); ++i) {
+        int diagonal = row[0];
+        row[0] = i;
+        for (int j = 1; j <= y.size(); ++j) {
+            int above = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1,
+                               diagonal + (x[i - 1] != y[j - 1] ? 1 : 0)});
+            diagonal = above;
+        }
+    }
+    return row.back();
+}
+
+}  // namespace
+
+std::array<double, 4> fitnessDiversity(const std::vector<Individual>& population) {
+    std::array<double, 4> avg{0.0, 0.0, 0.0, 0.0};
+    std::array<double, 4> var{0.0, 0.0, 0.0, 0.0};
+
+    for (const auto& individual : population) {
+        avg[0] += individual.fitness.fitness;
+        avg[1] += individual.fitness.fitnessProg;
+        avg[2] += individual.fitness.cpState;
+        avg[3] += static_cast<double>(-individual.fitness.length);
+    }
+
+    // Average.
+    for (auto& x : avg) {
+        x /= static_cast<double>(population.size());
+    }
+
+    // Variance.
+    for (const auto& individual : population) {
+        var[0] += std::pow(individual.fitness.fitness - avg[0], 2.0);
+        var[1] += std::pow(individual.fitness.fitnessProg - avg[1], 2.0);
+        var[2] += std::pow(individual.fitness.cpState - avg[2], 2.0);
+        var[3] += std::pow(-individual.fitness.length - avg[3], 2.0);
+    }
+
+    // Standard deviation.
+    for (auto& x : var) {
+        x = std::sqrt(x / population.size());
+    }
+    return var;
+}
+
+std::array<double, 2> genotypeDiversity(const std::vector<Individual>& population) {
+    const int n = population.size();
+    if (n == 0) {
+        return {0.0, 0.0};
+    }
+
+    SequenceSet distinct;
+    distinct.reserve(n);
+    for (const auto& individual : population) {
+        distinct.insert(&individual.sequence);
+    }
+
+    // Pairs half the population apart, spread evenly over it. They are picked
+    // without the RNG, so that measuring leaves the run as it was.
+    const int pairs = std::min(n / 2, EDIT_DISTANCE_PAIRS);
+    double    distance = 0.0;
+    for (int p = 0; p < pairs; ++p) {
+        int i = p * (n / 2) / pairs;
+        distance += editDistance(population[i].sequence, population[i + n / 2].sequence);
+    }
+    return {static_cast<double>(distinct.size()) / n,
+            pairs > 0 ? distance / pairs : 0.0};
+}
@@ -0,0 +1,37 @@
+#ifndef SOLVER_DIVERSITY_HH_
+#define SOLVER_DIVERSITY_HH_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "Individual.hh"
+
+// Sequences held elsewhere, hashed and compared by value.
+struct SequenceHash {
+    size_t operator()(const ActionSequence* sequence) const noexcept {
+        // FNV-1a over the action ids.
+        uint64_t hash = 14695981039346656037ull;
+        for (ActionId actionId : *sequence) {
+            hash = (hash ^ static_cast<uint64_t>(actionId)) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
+struct SequenceEqual {
+    bool operator()(const ActionSequence* x, const ActionSequence* y) const noexcept {
+        return *x == *y;
+    }
+};
+using SequenceSet =
+    std::unordered_set<const ActionSequence*, SequenceHash, SequenceEqual>;
+
+// Standard deviations of the population's fitness, progress, CP and length.
+std::array<double, 4> fitnessDiversity(const std::vector<Individual>& population);
+
+// Share of distinct sequences, and mean edit distance of a sample of pairs.
+std::array<double, 2> genotypeDiversity(const std::vector<Individual>& population);
+
+#endif  // SOLVER_DIVERSITY_HH_
@@ -1,37 +1,70 @@
 #include "Solver.hh"
 
 #include <algorithm>
+#include <cstdarg>
 #include <cstdio>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <numeric>
+#include <sstream>
 #include <stdexcept>
+#include <tuple>
 
 #include "../actions/ActionTable.hh"
 #include "../model/State.hh"
 #include "../model/Synth.hh"
 #include "ConditionalActionHandling.hh"
+#include "Diversity.hh"
 #include "Individual.hh"
 #include "SolverSettings.hh"
 #include "SolverVars.hh"
+#include "beam/BeamSearch.hh"
+#include "mcts/MonteCarloTreeSearch.hh"
+#include "polish/LocalSearch.hh"
+#include "profile/Profiler.hh"
+#include "profile/Trace.hh"
+#include "telemetry/TelemetryWriter.hh"
 
 using dist_range = std::uniform_int_distribution<int32_t>::param_type;
 
-Solver::Solver(SolverSettings& settings)
+namespace {
+
+// Odds of the mutations, in proportion, that subpopulations start with.
+constexpr std::array<double, MUTATION_COUNT> MUTATION_WEIGHTS{
+    // randomSubSeq
+    60,
+    // swap
+    10,
+    // reverse
+    10,
+    // randomPoint
+    60,
+    // killSubSeq
+    0,
+};
+
+// Mutations an offspring gets for not being a duplicate, before it is
+// replaced by a random sequence.
+constexpr int MAX_DUPLICATE_MUTATIONS = 3;
+
+}  // namespace
+
+Solver::Solver(SolverSettings& settings) : Solver(settings, nullptr) {}
+
+Solver::Solver(SolverSettings& settings, ThreadPool& pool) : Solver(settings, &pool) {}
+
+Solver::Solver(SolverSettings& settings, ThreadPool* pool)
     : settings(settings),
+      _ownPool(pool ? nullptr : std::make_unique<ThreadPool>(settings.threads)),
+      _pool(pool ? *pool : *_ownPool),
+      _stop(nullptr),
+      _cache(nullptr),
+      _evaluations(0),
+      _duplicates(0),
       _rng(_seed()),
       _distFloat(0.0, 1.0),
       _distInt(0, INT32_MAX),
-      _distMut({
-          // randomSubSeq
-          60,
-          // swap
-          10,
-          // reverse
-          10,
-          // randomPoint
-          60,
-          // killSubSeq
-          0,
-      }),
       _distLen1({
           // [2-8]
           90,
@@ -41,12 +74,40 @@ Solver::Solver(SolverSettings& settings)
           10,
       }) {}
 
+const Individual& Solver::best() const { return _best; }
+
+const MonteCarloStats& Solver::stats() const { return _stats; }
+
+void Solver::setBestCallback(BestCallback callback) {
+    _bestCallback = std::move(callback);
+}
+
+void Solver::setInitialPopulation(std::vector<Individual> population) {
+    _initialPopulation = std::move(population);
+}
+
+const std::vector<Individual>& Solver::population() const { return _population; }
+
+std::vector<std::array<OperatorStats, GENETIC_OPERATOR_COUNT>> Solver::operatorStats()
+    const {
+    std::vector<std::array<OperatorStats, GENETIC_OPERATOR_COUNT>> stats;
+    for (const AdaptivePursuit& pursuit : _pursuits) {
+        stats.push_back(pursuit.stats());
+    }
+    return stats;
+}
+
+void Solver::setStopFlag(const std::atomic<bool>& stop) { _stop = &stop; }
+
+void Solver::setSolutionCache(SolutionCache& cache) { _cache = &cache; }
+
 void Solver::solve() {
+    _evaluations = 0;
     if (settings.maxLength > 0) {
-        printf("Maximum length limit of %d is in effect!\n", settings.maxLength);
+        log("Maximum length limit of %d is in effect!\n", settings.maxLength);
     }
 
-    printf(
+    log(
         "Crafter:\n  Class: %s\n  Level: %d\n  Craftsmanship: %d\n  Control: %d\n  "
         "CP: "
         "%d\n  Specialist: %s\n\n",
@@ -54,14 +115,14 @@ void Solver::solve() {
         settings.crafter.craftsmanship, settings.crafter.control,
         settings.crafter.craftingPoints, bool2str(settings.crafter.isSpecialist));
 
-    printf(
+    log(
         "Recipe:\n  Level: %d\n  Difficulty: %d\n  Durability: %d\n  Start Quality: "
         "%d\n "
         " Max Quality: %d\n\n",
         settings.recipe.level, settings.recipe.difficulty, settings.recipe.durability,
         settings.recipe.startQuality, settings.recipe.maxQuality);
 
-    printf(
+    log(
         "Settings:\n  Max Trick Uses: %d\n  Reliability: %d %% \n  Use Conditions: "
         "%s\n  "
         "Population: %d\n  Generations: %d\n  Penalty Weight: %.0f\n\n",
@@ -76,9 +137,9 @@ void Solver::solve() {
     std::sort(crafterActionNames.begin(), crafterActionNames.end());
 
     if (settings.debug) {
-        printf("Crafter Actions:\n");
+        log("Crafter Actions:\n");
         for (int i = 0; i < crafterActionNames.size(); ++i) {
-            printf("  %d: %s\n", i, crafterActionNames[i].c_str());
+            log("  %d: %s\n", i, crafterActionNames[i].c_str());
         }
     }
 
@@ -96,18 +157,18 @@ void Solver::solve() {
         heuristicGuess = true;
         sequence = synth.buildHeuristicSequence();
 
-        printf(
+        log(
             "No initial sequence provided; seeding with the following heuristic "
             "sequence:\n\n");
 
         for (int i = 0; i < sequence.size(); ++i) {
             if (i + 1 < sequence.size()) {
-                printf("%s | ", ALL_ACTIONS[sequence[i]].fullName);
+                log("%s | ", ALL_ACTIONS[sequence[i]].fullName);
             } else {
-                printf("%s", ALL_ACTIONS[sequence[i]].fullName);
+                log("%s", ALL_ACTIONS[sequence[i]].fullName);
             }
         }
-        printf("\n\n");
+        log("\n\n");
 
         std::vector<State> states = _monteCarloSim.sequence(
             sequence, State(synth), true, SkipUnusable, false, settings.debug);
@@ -117,43 +178,96 @@ void Solver::solve() {
         heuristicState.checkViolations(progressOk, cpOk, durabilityOk, trickOk,
                                        reliabilityOk);
 
-        printf("Heuristic sequence feasibility\n");
-        printf(
+        log("Heuristic sequence feasibility\n");
+        log(
             "Progress: %s, Durability: %s, CP: %s, Tricks: %s, "
             "Reliability: %s\n",
             bool2str(progressOk), bool2str(durabilityOk), bool2str(cpOk),
             bool2str(trickOk), bool2str(reliabilityOk));
     }
 
-    // Initialize state vectors.
-    _best.fitness.fitness = std::numeric_limits<double>::lowest();
-    _lastFitnesses.resize(settings.solver.subPopulations);
-    _lastLeaderboard.resize(settings.solver.subPopulations);
-    _stagnationCounter.resize(settings.solver.subPopulations);
+    bool cached = findCachedSolution(synth);
+    if (cached) {
+        log("Using the cached solution with fitness %.1f.\n", _best.fitness.fitness);
+    } else if (settings.engine == Beam) {
+        BeamSearch beamSearch(settings, _pool, _stop);
+        _best = beamSearch.search(synth);
+    } else if (settings.engine == Mcts) {
+        // Playouts finish the craft with the best macro found without conditions,
+        // which can't rely on conditional actions.
+        SolverSettings         referenceSettings(settings);
+        std::vector<ActionId>& actions = referenceSettings.crafter.actions;
+        actions.erase(std::remove_if(actions.begin(), actions.end(),
+                                     [](ActionId actionId) {
+                                         return ALL_ACTIONS[actionId].isConditional;
+                                     }),
+                      actions.end());
+
+        BeamSearch beamSearch(referenceSettings, _pool, _stop);
+        Individual reference = beamSearch.search(synthNoConditions);
+
+        MonteCarloTreeSearch treeSearch(settings, _pool, _stop);
+        _policy = treeSearch.search(synth, reference.sequence);
+        _policyTable = PolicyTable(_policy, synth,
+                                   settings.mcts.policyBuckets > 0
+                                       ? settings.mcts.policyBuckets
+                                       : 8);
+        prunePolicy(synth);
+
+        _best.sequence = _policy.principal;
+        _best.fitness = evalSeq(_best, synth, settings.solver.penaltyWeight);
+    } else {
+        // A checkpoint carries on with the odds it was written with.
+        resetOperators();
+
+        bool resumed = false;
+        if (settings.checkpoint.resume && !settings.checkpoint.path.empty()) {
+            std::optional<Checkpoint> checkpoint =
+                Checkpoint::load(settings.checkpoint.path);
+            if (checkpoint) {
+                restoreCheckpoint(*checkpoint);
+                resumed = true;
+                log("Resuming from generation %d of %s\n", _generationNumber,
+                    settings.checkpoint.path.c_str());
+            } else {
+                log("No checkpoint at %s, starting from scratch.\n",
+                    settings.checkpoint.path.c_str());
+            }
+        }
 
-    std::iota(_lastLeaderboard.begin(), _lastLeaderboard.end(), 0);
-    std::fill(_stagnationCounter.begin(), _stagnationCounter.end(), 0);
+        if (!resumed) {
+            initializePopulation(synth, sequence);
+        }
 
-    // Initialize population with the initial guess and random sequences.
-    _population = {sequence};
-    for (int i = 1; i < settings.solver.population; ++i) {
-        _population.emplace_back(randomActionSequence());
-    }
+        run(synth);
+        logOperatorStats();
 
-    // Initialize fitness for the initial population.
-    for (auto& ind : _population) {
-        ind.fitness = evalSeq(ind.sequence, synth, settings.solver.penaltyWeight);
+        // A stopped run wants its answer now, not a better one later.
+        bool stopped = _stop != nullptr && *_stop;
+        if (settings.polish.maxEdits > 0 && !stopped) {
+            LocalSearch localSearch(settings, _pool);
+            Individual  polished =
+                localSearch.polish(_best, synth, settings.polish.maxEdits);
+
+            log("Polishing: best fitness %.1f -> %.1f\n", _best.fitness.fitness,
+                polished.fitness.fitness);
+            if (polished.fitness > _best.fitness) {
+                _best = std::move(polished);
+            }
+        }
     }
 
-    run(synth);
+    if (!cached) {
+        cacheSolution();
+    }
 
     ActionSequence best = _best.sequence;
 
-    printf("\n\n");
+    log("\n\n");
     for (int i = 0; i < best.size(); ++i) {
-        printf("%s\n", ALL_ACTIONS[best[i]].fullName);
+        log("%s\n", ALL_ACTIONS[best[i]].fullName);
     }
-    printf("\n");
+    log("\n");
 
     std::vector<State> states = _monteCarloSim.sequence(
         best, State(synth), true, SkipUnusable, false, settings.debug);
@@ -162,14 +276,191 @@ void Solver::solve() {
     bool progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
     finalState.checkViolations(progressOk, cpOk, durabilityOk, trickOk, reliabilityOk);
 
-    _monteCarloSim.execute(best, synth, 600, false, SkipUnusable, false, settings.debug);
+    _stats = _monteCarloSim.execute(best, synth, 600, false, SkipUnusable, false,
+                                    settings.debug);
+
+    if (settings.engine == Mcts) {
+        MonteCarloStats policyStats = _monteCarloSim.execute(
+            _policyTable, synth, 600, false, false, settings.debug);
+
+        log("Macro:  %5.1f %% success, %7.1f average quality\n", _stats.successPercent,
+            _stats.avgStats.quality);
+        log("Policy: %5.1f %% success, %7.1f average quality\n",
+            policyStats.successPercent, policyStats.avgStats.quality);
+    }
+}
+
+void Solver::prunePolicy(const Synth& synth) {
+    constexpr int nRuns = 2000;
+
+    // Expected playout reward, as the tree search scores it.
+    const auto score = [&synth](const MonteCarloStats& stats) {
+        if (stats.successPercent == 0) {
+            return 0.0;
+        }
+        double maxQuality = synth.recipe.maxQuality;
+        return stats.successPercent / 100 *
+               (0.1 + 0.9 * std::min(stats.avgStats.quality, maxQuality) / maxQuality);
+    };
+
+    // Every evaluation sees the same random outcomes, so that they differ by
+    // the decisions alone.
+    const unsigned seed = _rng();
+    const auto     evaluate = [&]() {
+        _monteCarloSim.seed(seed);
+        return score(
+            _monteCarloSim.execute(_policyTable, synth, nRuns, false, false, false));
+    };
+
+    // Tree statistics are noisy away from the principal line, so decisions only
+    // stay if the table does worse without them.
+    double           best = evaluate();
+    std::vector<int> cells = _policyTable.decidedCells();
+    for (int cell : cells) {
+        ActionId action = _policyTable.decision(cell);
+        _policyTable.setDecision(cell, NoAction);
+
+        double value = evaluate();
+        if (value >= best) {
+            best = value;
+        } else {
+            _policyTable.setDecision(cell, action);
+        }
+    }
+
+    log("Policy table: kept %d of %d decisions.\n",
+        static_cast<int>(_policyTable.decidedCells().size()),
+        static_cast<int>(cells.size()));
+}
+
+bool Solver::findCachedSolution(const Synth& synth) {
+    if (_cache == nullptr && !settings.cache.path.empty()) {
+        _ownCache = std::make_unique<SolutionCache>(settings.cache.path);
+        _cache = _ownCache.get();
+    }
+
+    // The tree search is after a policy, which isn't cached.
+    if (_cache == nullptr || !settings.cache.lookup || settings.engine == Mcts) {
+        return false;
+    }
+
+    std::optional<SolutionCache::Entry> entry =
+        _cache->find(SolutionCache::key(settings));
+    if (!entry) {
+        return false;
+    }
+
+    _best.sequence = entry->sequence;
+    _best.fitness = evalSeq(_best, synth, settings.solver.penaltyWeight);
+    return true;
+}
+
+void Solver::cacheSolution() {
+    // Lookups take cached solutions as final, which those of stopped runs aren't.
+    if (_cache == nullptr || settings.engine == Mcts || (_stop != nullptr && *_stop)) {
+        return;
+    }
+
+    SolutionCache::Entry entry{SolutionCache::features(settings), _best.fitness,
+                               _best.sequence};
+    if (_cache->store(SolutionCache::key(settings), entry)) {
+        log("Stored the solution in the cache.\n");
+    }
+}
+
+void Solver::seedFromCache() {
+    const CacheVars& cache = settings.cache;
+    if (_cache == nullptr || cache.seedFraction <= 0 || cache.seedNeighbours <= 0) {
+        return;
+    }
+
+    std::vector<SolutionCache::Entry> neighbours =
+        _cache->nearest(SolutionCache::features(settings), cache.seedNeighbours);
+
+    // Solutions of other crafts may use actions this crafter doesn't have.
+    std::vector<ActionSequence> seeds;
+    for (const SolutionCache::Entry& entry : neighbours) {
+        ActionSequence seed;
+        std::copy_if(entry.sequence.begin(), entry.sequence.end(),
+                     std::back_inserter(seed),
+                     [this](ActionId actionId) {
+                         return settings.crafter.hasAction(actionId);
+                     });
+        if (!seed.empty()) {
+            seeds.push_back(std::move(seed));
+        }
+    }
+    if (seeds.empty()) {
+        return;
+    }
+
+    // Fill the back of every subpopulation, which leaves the initial guess at the
+    // front of the first one alone. Copies beyond the first of every seed are
+    // mutated to spread the subpopulation around it.
+    int subPopulations = settings.solver.subPopulations;
+    int seeded = 0;
+    for (int subpop = 0; subpop < subPopulations; ++subpop) {
+        int subpopStartIndex = subpop * _population.size() / subPopulations;
+        int subpopEndIndex = (subpop + 1) * _population.size() / subPopulations;
+        int subpopLength = subpopEndIndex - subpopStartIndex;
+        int nSeeds = std::min<int>(subpopLength * cache.seedFraction, subpopLength - 1);
+
+        for (int i = 0; i < nSeeds; ++i) {
+            Individual seed(seeds[i % seeds.size()]);
+            if (i >= seeds.size()) {
+                seed = mutate(seed, _pursuits[subpop].pick(random()));
+            }
+            _population[subpopEndIndex - 1 - i] = std::move(seed);
+            seeded += 1;
+        }
+    }
+
+    log("Seeded %d individuals from %d cached solutions of similar crafts.\n", seeded,
+        static_cast<int>(seeds.size()));
+}
+
+void Solver::initializePopulation(const Synth& synth, const ActionSequence& sequence) {
+    // Initialize state vectors.
+    _best.fitness.fitness = std::numeric_limits<double>::lowest();
+    _lastFitnesses.assign(settings.solver.subPopulations, 0);
+    _lastLeaderboard.resize(settings.solver.subPopulations);
+    _stagnationCounter.assign(settings.solver.subPopulations, 0);
+
+    std::iota(_lastLeaderboard.begin(), _lastLeaderboard.end(), 0);
+
+    if (_initialPopulation.size() == settings.solver.population) {
+        _population = std::move(_initialPopulation);
+        log("Starting from the given population.\n");
+    } else {
+        // Initialize population with the initial guess and random sequences.
+        _population = {sequence};
+        for (int i = 1; i < settings.solver.population; ++i) {
+            _population.emplace_back(randomActionSequence());
+        }
+        seedFromCache();
+    }
+
+    // Initialize fitness for the initial population.
+    for (auto& ind : _population) {
+        ind.fitness = evalSeq(ind.sequence, synth, settings.solver.penaltyWeight);
+    }
+
+    _generationNumber = 0;
+    _staleGenerations = 0;
+    _lastBest = _best.fitness;
 }
 
 Fitness Solver::evalSeq(const Individual& individual, const Synth& synth,
                         double penaltyWeight) {
+    ++_evaluations;
     State startState(synth);
     State result =
         _simSynth.execute(individual.sequence, startState, false, false, false);
+    return evalState(result, synth, penaltyWeight, individual.sequence.size());
+}
+
+Fitness Solver::evalState(const State& result, const Synth& synth, double penaltyWeight,
+                          int length) {
     double penalty(0);
     double fitness(0);
     double fitnessProg(0);
@@ -229,8 +520,7 @@ Fitness Solver::evalSeq(const Individual& individual, const Synth& synth,
     // fitness -= result._cpState * 0.5;  // Penalizes wasted CP
     fitnessProg += result._progressState;
 
-    return {fitness, fitnessProg, result._cpState,
-            static_cast<int>(individual.sequence.size())};
+    return {fitness, fitnessProg, result._cpState, length};
 }
 
 void Solver::mutateRandomSubSequence(ActionSequence& individual) {
@@ -257,7 +547,7 @@ void Solver::mutateReverse(ActionSequence& individual) {
     if (individual.size() >= 6) {
         int i = randomInt(0, individual.size() / 2);  // Where to start reversing
         int j = randomInt(0, individual.size() - i);  // How many elements to reverse
-        std::reverse(individual.begin() + i, individual.begin() + j + 1);
+        std::reverse(individual.begin() + i, individual.begin() + i + j);
     }
 }
 
@@ -281,26 +571,27 @@ void Solver::mutateKillSubSequence(ActionSequence& individual) {
     individual.erase(individual.begin() + start, individual.begin() + start + seqLength);
 }
 
-Individual Solver::mutate(const Individual& individual) {
+Individual Solver::mutate(const Individual& individual, GeneticOperator mutation) {
     Individual indMut(individual);
 
-    int mut = _distMut(_rng);
-    switch (mut) {
-        case 0:
+    switch (mutation) {
+        case MutateRandomSubSequence:
             mutateRandomSubSequence(indMut.sequence);
             break;
-        case 1:
+        case MutateSwap:
             mutateSwap(indMut.sequence);
             break;
-        case 2:
-            mutateRandomSubSequence(indMut.sequence);
+        case MutateReverse:
+            mutateReverse(indMut.sequence);
             break;
-        case 3:
+        case MutatePoint:
             mutatePoint(indMut.sequence);
             break;
-        case 4:
+        case MutateKillSubSequence:
             mutateKillSubSequence(indMut.sequence);
             break;
+        default:
+            break;
     }
 
     // If this killed the individual we'll replace it with a new random sequence.
@@ -338,34 +629,89 @@ std::pair<Individual, Individual> Solver::crossover(const Individual& ind1,
 }
 
 void Solver::run(const Synth& synth) {
-    printf("\n");
+    log("\n");
 
-    for (_generationNumber = 1; _generationNumber <= settings.solver.generations;
+    const auto start = std::chrono::steady_clock::now();
+    const auto elapsed = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    };
+
+    const CheckpointVars&             checkpoint = settings.checkpoint;
+    std::unique_ptr<CheckpointWriter> checkpointWriter;
+    if (!checkpoint.path.empty() && checkpoint.interval > 0) {
+        checkpointWriter = std::make_unique<CheckpointWriter>(checkpoint.path);
+    }
+
+    // A resumed solve carries on with the file it wrote before.
+    const TelemetryVars&             telemetry = settings.telemetry;
+    std::unique_ptr<TelemetryWriter> telemetryWriter;
+    if (!telemetry.path.empty()) {
+        telemetryWriter = std::make_unique<TelemetryWriter>(
+            telemetry.path, telemetry.format, _generationNumber > 0);
+    }
+
+    // A solve runs on one thread, apart from what it spreads over the pool.
+    const PhaseTotals profileStart = Profiler::threadTotals();
+    PhaseTotals       profileLast = profileStart;
+
+    for (++_generationNumber; _generationNumber <= settings.solver.generations;
          ++_generationNumber) {
+        const double generationStart = elapsed();
+        const long   evaluationsStart = _evaluations;
         runOneGen(synth);
 
+        if (settings.polish.eliteInterval > 0 &&
+            _generationNumber % settings.polish.eliteInterval == 0) {
+            PROFILE_PHASE(PhasePolish);
+            TraceSpan span("polish", "generation", _generationNumber);
+            polishElites(synth);
+        }
+
+        if (_best.fitness > _lastBest) {
+            _lastBest = _best.fitness;
+            _staleGenerations = 0;
+            reportNewBest(elapsed());
+        } else {
+            _staleGenerations += 1;
+        }
+
         if (settings.debug) {
             Fitness fitness = evalSeq(_best, synth, settings.solver.penaltyWeight);
-            std::array<double, 4> popDiversity = calcPopDiversity();
+            std::array<double, 4> popDiversity = fitnessDiversity(_population);
 
-            printf(
+            log(
                 "Generation [%d]: best fitness = [%.1f, %.1f, %.1f, %d], pop "
                 "diversity = [",
                 _generationNumber, fitness.fitness, fitness.fitnessProg, fitness.cpState,
                 fitness.length);
 
             for (int i = 0; i < popDiversity.size(); ++i) {
-                printf("%.1f", popDiversity[i]);
+                log("%.1f", popDiversity[i]);
                 if (i + 1 < popDiversity.size()) {
-                    printf(", ");
+                    log(", ");
                 }
             }
 
-            printf("], pop size: %d\n\n", static_cast<int>(_population.size()));
-        } else {
+            log("], pop size: %d\n", static_cast<int>(_population.size()));
+
+            std::array<double, 2> genotypes = genotypeDiversity(_population);
+            log("  Distinct sequences: %.1f%%, mean edit distance: %.1f, "
+                "duplicates: %d\n",
+                100 * genotypes[0], genotypes[1], _duplicates);
+
+            if (PROFILING) {
+                PhaseTotals profile = Profiler::threadTotals();
+                log("  Phases: %s\n",
+                    Profiler::formatLine(profile - profileLast).c_str());
+                profileLast = profile;
+            }
+            log("\n");
+        } else if (!settings.quiet) {
+            PROFILE_PHASE(PhaseProgress);
             MonteCarloStats stats = _monteCarloSim.execute(
                 _best.sequence, synth, 600, false, SkipUnusable, false, false);
-            printf(
+            log(
                 "Gen %5d/%5d -=- Progress: %4d/%4d - Quality: %5d/%5d - CP: %3d/%3d - "
                 "Dur: "
                 "%3d/%2d - Steps: %2d\r",
@@ -378,13 +724,182 @@ void Solver::run(const Synth& synth) {
                 synth.recipe.durability, (int)_best.sequence.size());
             fflush(stdout);
         }
+
+        const char* reason = terminationReason(synth, elapsed(), _staleGenerations);
+
+        if (checkpointWriter && (_generationNumber % checkpoint.interval == 0 ||
+                                 _generationNumber == settings.solver.generations ||
+                                 reason != nullptr)) {
+            PROFILE_PHASE(PhaseCheckpoint);
+            TraceSpan span("checkpoint", "generation", _generationNumber);
+            checkpointWriter->write(makeCheckpoint());
+        }
+
+        if (telemetryWriter && (_generationNumber % telemetry.interval == 0 ||
+                                _generationNumber == settings.solver.generations ||
+                                reason != nullptr)) {
+            // The writer measures the diversity of its copy of the population.
+            const double seconds = elapsed();
+            telemetryWriter->write({
+                .generation = _generationNumber,
+                .seconds = seconds,
+                .generationSeconds = seconds - generationStart,
+                .evaluations = _evaluations - evaluationsStart,
+                .totalEvaluations = _evaluations,
+                .best = _best.fitness,
+                .duplicates = _duplicates,
+                .lastFitnesses = _lastFitnesses,
+                .stagnationCounter = _stagnationCounter,
+                .population = _population,
+            });
+        }
+
+        if (reason != nullptr) {
+            log("\nStopping after generation %d (%.2f s): %s.\n", _generationNumber,
+                elapsed(), reason);
+            break;
+        }
     }
 
     if (!settings.debug) {
-        printf("\n");
+        log("\n");
+    }
+    if (PROFILING) {
+        log("Time by phase, on the solving thread:\n%s",
+            Profiler::format(Profiler::threadTotals() - profileStart).c_str());
+    }
+}
+
+void Solver::log(const char* format, ...) const {
+    if (settings.quiet) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+Checkpoint Solver::makeCheckpoint() const {
+    std::ostringstream rngState;
+    rngState << _rng;
+
+    return {
+        .settingsFingerprint = Checkpoint::fingerprint(settings),
+        .generation = _generationNumber,
+        .staleGenerations = _staleGenerations,
+        .subPopulations = settings.solver.subPopulations,
+        .evaluations = static_cast<uint64_t>(_evaluations),
+        .population = _population,
+        .best = _best,
+        .lastBest = _lastBest,
+        .lastFitnesses = _lastFitnesses,
+        .stagnationCounter = _stagnationCounter,
+        .lastLeaderboard = _lastLeaderboard,
+        .operatorStats = operatorStats(),
+        .rngState = rngState.str(),
+    };
+}
+
+void Solver::restoreCheckpoint(const Checkpoint& checkpoint) {
+    if (checkpoint.subPopulations != settings.solver.subPopulations ||
+        checkpoint.population.size() != settings.solver.population) {
+        throw std::invalid_argument(
+            "Checkpoint was written with a different population or number of "
+            "subpopulations.");
+    }
+    if (checkpoint.settingsFingerprint != Checkpoint::fingerprint(settings)) {
+        throw std::invalid_argument(
+            "Checkpoint was written for another craft or other solver settings.");
+    }
+
+    std::istringstream rngState(checkpoint.rngState);
+    rngState >> _rng;
+    if (!rngState) {
+        throw std::invalid_argument("Checkpoint has an invalid random number state.");
+    }
+
+    _generationNumber = checkpoint.generation;
+    _staleGenerations = checkpoint.staleGenerations;
+    _evaluations = checkpoint.evaluations;
+    _population = checkpoint.population;
+    _best = checkpoint.best;
+    _lastBest = checkpoint.lastBest;
+    _lastFitnesses = checkpoint.lastFitnesses;
+    _stagnationCounter = checkpoint.stagnationCounter;
+    _lastLeaderboard = checkpoint.lastLeaderboard;
+    for (int subpop = 0; subpop < _pursuits.size(); ++subpop) {
+        _pursuits[subpop].restore(checkpoint.operatorStats[subpop]);
     }
 }
 
+void Solver::reportNewBest(double seconds) {
+    if (_bestCallback) {
+        _bestCallback(_best, seconds);
+    }
+
+    if (settings.termination.anytime) {
+        log("\n[%8.3f s] Generation %d: new best fitness %.1f, %d steps\n", seconds,
+            _generationNumber, _best.fitness.fitness, _best.fitness.length);
+        for (int i = 0; i < _best.sequence.size(); ++i) {
+            if (i + 1 < _best.sequence.size()) {
+                log("%s | ", ALL_ACTIONS[_best.sequence[i]].fullName);
+            } else {
+                log("%s", ALL_ACTIONS[_best.sequence[i]].fullName);
+            }
+        }
+        log("\n");
+    }
+}
+
+const char* Solver::terminationReason(const Synth& synth, double seconds,
+                                      int staleGenerations) {
+    const TerminationVars& termination = settings.termination;
+
+    if (_stop != nullptr && *_stop) {
+        return "stopped";
+    }
+
+    if (termination.timeLimit > 0 && seconds >= termination.timeLimit) {
+        return "time limit reached";
+    }
+
+    if (termination.targetFitness &&
+        _best.fitness.fitness >= *termination.targetFitness) {
+        return "target fitness reached";
+    }
+
+    if (termination.maxStaleGenerations > 0 &&
+        staleGenerations >= termination.maxStaleGenerations) {
+        return "no improvement";
+    }
+
+    if (termination.stopAtMaxQuality && !synth.solverVars.solveForCompletion &&
+        reachesMaxQuality(_best.sequence, synth)) {
+        return "quality cap reached";
+    }
+
+    return nullptr;
+}
+
+bool Solver::reachedMaxQuality() {
+    Synth synth(settings.crafter, settings.recipe, settings.maxTrickUses,
+                settings.reliabilityPercent / 100.0, settings.useConditions,
+                settings.maxLength, settings.solver);
+    return reachesMaxQuality(_best.sequence, synth);
+}
+
+bool Solver::reachesMaxQuality(const ActionSequence& sequence, const Synth& synth) {
+    State result = _simSynth.execute(sequence, State(synth), false, false, false);
+
+    bool progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
+    result.checkViolations(progressOk, cpOk, durabilityOk, trickOk, reliabilityOk);
+
+    double maxQuality = synth.recipe.maxQuality * (1 + synth.recipe.safetyMargin * 0.01);
+    return progressOk && cpOk && durabilityOk && result._qualityState >= maxQuality;
+}
+
 std::vector<Individual> Solver::selRandom(int k, int startIndex, int endIndex) {
     std::vector<Individual> r(k);
     for (int i = 0; i < k; ++i) {
@@ -404,38 +919,88 @@ std::vector<Individual> Solver::selTournament(int size, int k, int startIndex,
 }
 
 std::vector<Individual> Solver::varCrossover(const std::vector<Individual>& parents,
-                                             double                         cxpb) {
+                                             double                         cxpb,
+                                             std::vector<unsigned>&         operators) {
     std::vector<Individual> offspring(parents);
     for (int i = 1; i < offspring.size(); i += 2) {
         if (random() < cxpb) {
             std::tie(offspring[i - 1], offspring[i]) =
                 crossover(offspring[i - 1], offspring[i]);
+            operators[i - 1] |= 1u << Crossover;
+            operators[i] |= 1u << Crossover;
         }
     }
     return offspring;
 }
 
-void Solver::varMutate(std::vector<Individual>& offspring, double mutpb) {
-    for (auto& ind : offspring) {
+void Solver::varMutate(std::vector<Individual>& offspring, double mutpb,
+                       const AdaptivePursuit& pursuit, std::vector<unsigned>& operators) {
+    const auto mutateOnce = [&](int k) {
+        GeneticOperator mutation = pursuit.pick(random());
+        offspring[k] = mutate(offspring[k], mutation);
+        operators[k] |= 1u << mutation;
+    };
+
+    for (int k = 0; k < offspring.size(); ++k) {
         if (random() < mutpb) {
-            ind = mutate(ind);
+            mutateOnce(k);
             // Chance to mutate more.
             for (int i = 0; i < 5; ++i) {
                 if (random() < 0.5) {
-                    ind = mutate(ind);
+                    mutateOnce(k);
                 }
             }
         }
     }
 }
 
+int Solver::eliminateDuplicates(std::vector<Individual>::const_iterator begin,
+                                std::vector<Individual>::const_iterator end,
+                                std::vector<Individual>&                offspring,
+                                const AdaptivePursuit&                  pursuit,
+                                std::vector<unsigned>&                  operators) {
+    SequenceSet seen;
+    seen.reserve((end - begin) + offspring.size());
+    for (auto it = begin; it != end; ++it) {
+        seen.insert(&it->sequence);
+    }
+
+    // An offspring's sequence is only added once it is final. It may stay a
+    // duplicate if every try gives another one.
+    int duplicates = 0;
+    for (int k = 0; k < offspring.size(); ++k) {
+        if (seen.insert(&offspring[k].sequence).second) {
+            continue;
+        }
+        ++duplicates;
+        for (int i = 0; i <= MAX_DUPLICATE_MUTATIONS; ++i) {
+            if (i < MAX_DUPLICATE_MUTATIONS) {
+                GeneticOperator mutation = pursuit.pick(random());
+                offspring[k] = mutate(offspring[k], mutation);
+                operators[k] |= 1u << mutation;
+            } else {
+                offspring[k].sequence = randomActionSequence();
+                operators[k] = 0;
+            }
+            if (seen.insert(&offspring[k].sequence).second) {
+                break;
+            }
+        }
+    }
+    return duplicates;
+}
+
 void Solver::runOneGen(const Synth& synth) {
+    PROFILE_PHASE(PhaseGeneration);
+    TraceSpan span("generation", "generation", _generationNumber);
+
     // Comparator to sort individuals by decreasing fitness.
     const auto fitComp = [](const auto& x, const auto& y) {
         return x.fitness > y.fitness;
     };
 
     int subPopulations = settings.solver.subPopulations;
+    _duplicates = 0;
 
     int    winningSubpop = 0;
     double highestFitness = std::numeric_limits<double>::lowest();
@@ -448,6 +1013,8 @@ void Solver::runOneGen(const Synth& synth) {
         auto subpopBegin = _population.begin() + subpopStartIndex;
         auto subpopEnd = _population.begin() + subpopEndIndex;
 
+        TraceSpan subpopSpan("subpopulation", "subpopulation", subpop);
+
         // If this subpopulation has stagnated for too long,
         // reset with a new random guess.
         // The top third of the subpopulations get 3x as much time to improve.
@@ -458,29 +1025,65 @@ void Solver::runOneGen(const Synth& synth) {
                 evalSeq(random.sequence, synth, settings.solver.penaltyWeight);
             std::fill(subpopBegin, subpopEnd, random);
             if (settings.debug) {
-                printf("Subpopulation %d has been wiped due to stagnation.\n",
-                       subpop + 1);
+                log("Subpopulation %d has been wiped due to stagnation.\n", subpop + 1);
             }
         }
 
         // Select parents.
-        std::vector<Individual> parents =
-            selTournament(7, subpopLength / 2, subpopStartIndex, subpopEndIndex);
+        std::vector<Individual> parents;
+        {
+            PROFILE_PHASE(PhaseSelection);
+            parents =
+                selTournament(7, subpopLength / 2, subpopStartIndex, subpopEndIndex);
+        }
 
-        // Breed offspring.
-        std::vector<Individual> offspring =
-            varCrossover(parents, settings.solver.probCrossover);
-        varMutate(offspring, settings.solver.probMutation);
+        // Breed offspring, noting the operators that made each.
+        AdaptivePursuit&        pursuit = _pursuits[subpop];
+        std::vector<Individual> offspring;
+        std::vector<unsigned>   operators(parents.size(), 0);
+        {
+            PROFILE_PHASE(PhaseCrossover);
+            offspring = varCrossover(parents, settings.solver.probCrossover, operators);
+        }
+        {
+            PROFILE_PHASE(PhaseMutation);
+            varMutate(offspring, settings.solver.probMutation, pursuit, operators);
+            if (settings.solver.eliminateDuplicates) {
+                _duplicates += eliminateDuplicates(subpopBegin, subpopEnd, offspring,
+                                                   pursuit, operators);
+            }
+        }
 
         // Evaluate offspring.
-        for (auto& ind : offspring) {
-            ind.fitness = evalSeq(ind.sequence, synth, settings.solver.penaltyWeight);
+        {
+            PROFILE_PHASE(PhaseEvaluation);
+            for (auto& ind : offspring) {
+                ind.fitness = evalSeq(ind.sequence, synth, settings.solver.penaltyWeight);
+            }
         }
 
+        PROFILE_PHASE(PhaseSurvivors);
+
         // Select offspring. Only keep the best half.
-        int offspringKeepNum = offspring.size() / 2;
-        std::partial_sort(offspring.begin(), offspring.begin() + offspringKeepNum,
-                          offspring.end(), fitComp);
+        int              offspringKeepNum = offspring.size() / 2;
+        std::vector<int> order(offspring.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::partial_sort(order.begin(), order.begin() + offspringKeepNum, order.end(),
+                          [&offspring](int i, int j) {
+                              return offspring[i].fitness > offspring[j].fitness;
+                          });
+
+        // Operators succeed with the offspring they made that are kept and fitter
+        // than their parent.
+        for (int rank = 0; rank < order.size(); ++rank) {
+            int i = order[rank];
+            if (operators[i] != 0) {
+                bool success = rank < offspringKeepNum &&
+                               offspring[i].fitness > parents[i].fitness;
+                pursuit.credit(operators[i], success);
+            }
+        }
+        pursuit.update();
 
         // Select survivors.
         int survivorsKeepNum = subpopLength - offspringKeepNum;
@@ -488,8 +1091,9 @@ void Solver::runOneGen(const Synth& synth) {
                           fitComp);
 
         // Overwrite the rest of the subpop with the new offspring.
-        std::copy(offspring.begin(), offspring.begin() + offspringKeepNum,
-                  subpopBegin + survivorsKeepNum);
+        for (int rank = 0; rank < offspringKeepNum; ++rank) {
+            subpopBegin[survivorsKeepNum + rank] = std::move(offspring[order[rank]]);
+        }
 
         // Sort by fitness.
         std::sort(subpopBegin, subpopEnd, fitComp);
@@ -518,35 +1122,104 @@ void Solver::runOneGen(const Synth& synth) {
 
     // Debug.
     if (settings.debug) {
-        printf("  Winning subpopulation: %d, with fitness %.1f\n", winningSubpop + 1,
-               highestFitness);
+        log("  Winning subpopulation: %d, with fitness %.1f\n", winningSubpop + 1,
+            highestFitness);
 
-        printf("  Last fitnesses: [");
+        log("  Last fitnesses: [");
         for (int i = 0; i < _lastFitnesses.size(); ++i) {
-            printf("%.1f", _lastFitnesses[i]);
+            log("%.1f", _lastFitnesses[i]);
             if (i + 1 < _lastFitnesses.size()) {
-                printf(", ");
+                log(", ");
             }
         }
-        printf("]\n");
+        log("]\n");
 
-        printf("  Stagnation counter: [");
+        log("  Stagnation counter: [");
         for (int i = 0; i < _stagnationCounter.size(); ++i) {
-            printf("%d", _stagnationCounter[i]);
+            log("%d", _stagnationCounter[i]);
             if (i + 1 < _stagnationCounter.size()) {
-                printf(", ");
+                log(", ");
             }
         }
-        printf("]\n");
+        log("]\n");
 
-        printf("  Leaderboard: [");
+        log("  Leaderboard: [");
         for (int i = 0; i < _lastLeaderboard.size(); ++i) {
-            printf("%d", _lastLeaderboard[i]);
+            log("%d", _lastLeaderboard[i]);
             if (i + 1 < _lastLeaderboard.size()) {
-                printf(", ");
+                log(", ");
+            }
+        }
+        log("]\n");
+
+        const auto& stats = _pursuits[winningSubpop].stats();
+        log("  Mutation odds of the winning subpopulation: [");
+        for (int i = 0; i < MUTATION_COUNT; ++i) {
+            log("%s %.2f", operator2str(static_cast<GeneticOperator>(i)),
+                stats[i].probability);
+            if (i + 1 < MUTATION_COUNT) {
+                log(", ");
+            }
+        }
+        log("]\n");
+    }
+}
+
+void Solver::polishElites(const Synth& synth) {
+    LocalSearch localSearch(settings, _pool);
+
+    int subPopulations = settings.solver.subPopulations;
+    int improved = 0;
+
+    for (int subpop = 0; subpop < subPopulations; ++subpop) {
+        // Subpopulations are sorted, their best comes first.
+        Individual& elite = _population[subpop * _population.size() / subPopulations];
+        Individual  polished = localSearch.polish(elite, synth, 1);
+
+        if (polished.fitness > elite.fitness) {
+            elite = std::move(polished);
+            improved += 1;
+
+            if (elite.fitness > _best.fitness) {
+                _best = elite;
             }
         }
-        printf("]\n");
+    }
+
+    if (settings.debug) {
+        log("  Polishing improved %d of %d subpopulation elites.\n", improved,
+            subPopulations);
+    }
+}
+
+void Solver::resetOperators() {
+    _pursuits.assign(settings.solver.subPopulations,
+                     AdaptivePursuit(MUTATION_WEIGHTS, settings.operators));
+}
+
+void Solver::logOperatorStats() const {
+    if (!settings.debug && !settings.operators.adaptive) {
+        return;
+    }
+
+    log("Genetic operators over all subpopulations:\n");
+    for (int i = 0; i < GENETIC_OPERATOR_COUNT; ++i) {
+        long   applied = 0;
+        long   successes = 0;
+        double probability = 0;
+        for (const AdaptivePursuit& pursuit : _pursuits) {
+            const OperatorStats& op = pursuit.stats()[i];
+            applied += op.applied;
+            successes += op.successes;
+            probability += op.probability / _pursuits.size();
+        }
+        log("  %-18s applied %9ld, improved and kept %5.1f %%",
+            operator2str(static_cast<GeneticOperator>(i)), applied,
+            applied > 0 ? 100.0 * successes / applied : 0.0);
+        if (i < MUTATION_COUNT) {
+            log(", mean odds %.2f", probability);
+        }
+        log("\n");
     }
 }
 
@@ -580,37 +1253,6 @@ Individual Solver::maxByFitness(const std::vector<Individual>& inds) {
     return inds[maxIndex];
 }
 
-std::array<double, 4> Solver::calcPopDiversity() {
-    std::array<double, 4> avg{0.0, 0.0, 0.0, 0.0};
-    std::array<double, 4> var{0.0, 0.0, 0.0, 0.0};
-
-    for (const auto& individual : _population) {
-        avg[0] += individual.fitness.fitness;
-        avg[1] += individual.fitness.fitnessProg;
-        avg[2] += individual.fitness.cpState;
-        avg[3] += static_cast<double>(-individual.fitness.length);
-    }
-
-    // Average.
-    for (auto& x : avg) {
-        x /= static_cast<double>(_population.size());
-    }
-
-    // Variance.
-    for (const auto& individual : _population) {
-        var[0] += std::pow(individual.fitness.fitness - avg[0], 2.0);
-        var[1] += std::pow(individual.fitness.fitnessProg - avg[1], 2.0);
-        var[2] += std::pow(individual.fitness.cpState - avg[2], 2.0);
-        var[3] += std::pow(-individual.fitness.length - avg[3], 2.0);
-    }
-
-    // Standard deviation.
-    for (auto& x : var) {
-        x = std::sqrt(x / _population.size());
-    }
-    return var;
-}
-
 double Solver::random() { return _distFloat(_rng); }
 
 int Solver::randomInt(int min, int max) {
@@ -1,25 +1,81 @@
 #ifndef SOLVER_SOLVER_HH_
 #define SOLVER_SOLVER_HH_
 
+#include <atomic>
+#include <chrono>
 #include <duthomhas/csprng.hpp>
+#include <functional>
+#include <memory>
 #include <random>
 #include <utility>
 
 #include "Fitness.hh"
 #include "Individual.hh"
+#include "cache/SolutionCache.hh"
+#include "checkpoint/Checkpoint.hh"
+#include "mcts/Policy.hh"
+#include "mcts/PolicyTable.hh"
 #include "montecarlo/MonteCarloSim.hh"
+#include "operators/AdaptivePursuit.hh"
+#include "parallel/ThreadPool.hh"
 #include "simulation/SimSynth.hh"
 
 class SolverSettings;
+class State;
 class Synth;
 
 class Solver {
    public:
     Solver(SolverSettings& settings);
+    // Runs the parallel engines on a pool shared with other solvers.
+    Solver(SolverSettings& settings, ThreadPool& pool);
 
     void solve();
 
+    // Result of the last solve() and its Monte Carlo statistics.
+    const Individual&      best() const;
+    const MonteCarloStats& stats() const;
+
+    // Called with every new best of the genetic engine and the seconds elapsed
+    // since the run started, for callers that can act on a good enough macro.
+    using BestCallback = std::function<void(const Individual& best, double seconds)>;
+    void setBestCallback(BestCallback callback);
+
+    // Starts the genetic engine from the population of an earlier run, e.g. on a
+    // slightly different craft, instead of random sequences. Ignored unless it
+    // has settings.solver.population individuals.
+    void setInitialPopulation(std::vector<Individual> population);
+    const std::vector<Individual>& population() const;
+
+    // Whether the best macro finishes the craft at max quality, as checked by
+    // termination.stopAtMaxQuality.
+    bool reachedMaxQuality();
+
+    // Stops the genetic engine after the current generation once stop is set,
+    // keeping the best macro found so far unpolished. Beam search stops after the
+    // current depth and MCTS after the playouts already started.
+    void setStopFlag(const std::atomic<bool>& stop);
+
+    // Shares a solution cache with other solvers, in place of the one in
+    // settings.cache.path.
+    void setSolutionCache(SolutionCache& cache);
+
+    // How each genetic operator did in each subpopulation, over the last run.
+    std::vector<std::array<OperatorStats, GENETIC_OPERATOR_COUNT>> operatorStats() const;
+
+    // Fitness of the final state of a sequence of the given length.
+    static Fitness evalState(const State& result, const Synth& synth,
+                             double penaltyWeight, int length);
+
    private:
+    // Times the genetic engine's private steps.
+    friend class Benchmarks;
+
+    Solver(SolverSettings& settings, ThreadPool* pool);
+
+    // printf() unless the settings ask for quiet.
+    void log(const char* format, ...) const;
+
     Fitness evalSeq(const Individual& individual, const Synth& synth,
                     double penaltyWeight);
 
@@ -28,26 +84,59 @@ class Solver {
     void                              mutateReverse(ActionSequence& individual);
     void                              mutatePoint(ActionSequence& individual);
     void                              mutateKillSubSequence(ActionSequence& individual);
-    Individual                        mutate(const Individual& individual);
+    Individual                        mutate(const Individual& individual,
+                                             GeneticOperator   mutation);
     std::pair<Individual, Individual> crossover(const Individual& ind1,
                                                 const Individual& ind2);
 
     std::vector<Individual> selRandom(int k, int startIndex, int endIndex);
     std::vector<Individual> selTournament(int size, int k, int startIndex, int endIndex);
 
+    // Both set the bit of each operator they apply to an offspring in operators.
     std::vector<Individual> varCrossover(const std::vector<Individual>& parents,
-                                         double                         cxpb);
-    void                    varMutate(std::vector<Individual>& offspring, double mutpb);
-
+                                         double                         cxpb,
+                                         std::vector<unsigned>&         operators);
+    void                    varMutate(std::vector<Individual>& offspring, double mutpb,
+                                      const AdaptivePursuit&   pursuit,
+                                      std::vector<unsigned>&   operators);
+
+    // Mutates each offspring that has the sequence of an individual of
+    // [begin, end) or of an earlier offspring, a few times over if need be and
+    // then for a random sequence. Returns how many there were. Sets operator bits
+    // as the above do, and clears them for random sequences.
+    int eliminateDuplicates(std::vector<Individual>::const_iterator begin,
+                            std::vector<Individual>::const_iterator end,
+                            std::vector<Individual>&                offspring,
+                            const AdaptivePursuit&                  pursuit,
+                            std::vector<unsigned>&                  operators);
+
+    void prunePolicy(const Synth& synth);
+
+    bool findCachedSolution(const Synth& synth);
+    void cacheSolution();
+    void seedFromCache();
+
+    // The genetic engine's state before its first generation, with the given
+    // population or with sequence and random ones.
+    void initializePopulation(const Synth& synth, const ActionSequence& sequence);
     void run(const Synth& synth);
     void runOneGen(const Synth& synth);
 
+    Checkpoint makeCheckpoint() const;
+    void       restoreCheckpoint(const Checkpoint& checkpoint);
+    void       polishElites(const Synth& synth);
+    void       resetOperators();
+    void       logOperatorStats() const;
+
+    bool        reachesMaxQuality(const ActionSequence& sequence, const Synth& synth);
+    void        reportNewBest(double seconds);
+    const char* terminationReason(const Synth& synth, double seconds,
+                                  int staleGenerations);
+
     bool       isSubPopulationLosing(int subpop);
     bool       hasSubPopulationStagnatedTooMuch(int subpop);
     Individual maxByFitness(const std::vector<Individual>& inds);
 
-    std::array<double, 4> calcPopDiversity();
-
     double         random();
     int            randomInt(int min, int max);
     ActionId       randomAction();
@@ -58,20 +147,40 @@ class Solver {
     MonteCarloSim _monteCarloSim;
     SimSynth      _simSynth;
 
+    std::unique_ptr<ThreadPool> _ownPool;
+    ThreadPool&                 _pool;
+
+    BestCallback             _bestCallback;
+    const std::atomic<bool>* _stop;
+
+    std::unique_ptr<SolutionCache> _ownCache;
+    SolutionCache*                 _cache;
+
     int                     _generationNumber;
+    int                     _staleGenerations;
+    // Sequences evaluated in this solve.
+    long                    _evaluations;
+    // Offspring replaced as duplicates in the last generation.
+    int                     _duplicates;
+    Fitness                 _lastBest;
     std::vector<Individual> _population;
+    std::vector<Individual> _initialPopulation;
 
     Individual          _best;
+    MonteCarloStats     _stats;
+    Policy              _policy;
+    PolicyTable         _policyTable;
     std::vector<double> _lastFitnesses;
     std::vector<int>    _lastLeaderboard;
     std::vector<int>    _stagnationCounter;
+    // Odds of the mutations, and how all operators did, per subpopulation.
+    std::vector<AdaptivePursuit> _pursuits;
 
     // RNG
     duthomhas::csprng                      _seed;
     std::mt19937                           _rng;
     std::uniform_real_distribution<double> _distFloat;
     std::uniform_int_distribution<int32_t> _distInt;
-    std::discrete_distribution<int>        _distMut;
     std::discrete_distribution<int>        _distLen1;
 };
 
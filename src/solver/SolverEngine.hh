@@ -0,0 +1,10 @@
+#ifndef SOLVER_SOLVERENGINE_HH_
+#define SOLVER_SOLVERENGINE_HH_
+
+enum SolverEngine {
+    Genetic = 0,
+    Beam,
+    Mcts,
+};
+
+#endif  // SOLVER_SOLVERENGINE_HH_
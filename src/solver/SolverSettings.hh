@@ -7,6 +7,15 @@
 #include "../model/Crafter.hh"
 #include "../model/Recipe.hh"
 #include "../solver/SolverVars.hh"
+#include "SolverEngine.hh"
+#include "TerminationVars.hh"
+#include "beam/BeamSearchVars.hh"
+#include "cache/CacheVars.hh"
+#include "checkpoint/CheckpointVars.hh"
+#include "mcts/MctsVars.hh"
+#include "operators/OperatorVars.hh"
+#include "polish/PolishVars.hh"
+#include "telemetry/TelemetryVars.hh"
 
 struct SolverSettings {
     Recipe  recipe;
@@ -17,11 +26,27 @@ struct SolverSettings {
     int  maxLength;
     bool useConditions;
 
-    SolverVars solver;
+    SolverVars      solver;
+    OperatorVars    operators;
+    TerminationVars termination;
 
     std::vector<ActionId> sequence;
 
     bool debug;
+    // No console output at all, for solvers running side by side.
+    bool quiet;
+
+    SolverEngine   engine;
+    BeamSearchVars beam;
+    MctsVars       mcts;
+    PolishVars     polish;
+    CheckpointVars checkpoint;
+    CacheVars      cache;
+    TelemetryVars  telemetry;
+
+    // Worker threads used by the parallel engines. 0 uses all hardware threads.
+    // On a shared pool, the most threads this solver may take from it.
+    int threads;
 };
 
 #endif  // SOLVER_SOLVERSETTINGS_HH_
\ No newline at end of file
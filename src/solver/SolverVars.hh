@@ -13,6 +13,9 @@ struct SolverVars {
     double probCrossover;
     double probMutation;
     int    maxSubSeqLength;
+    // Mutates offspring that copy another individual of their subpopulation
+    // before they are evaluated, see Solver::eliminateDuplicates().
+    bool   eliminateDuplicates;
 };
 
 #endif  // SOLVER_SOLVERVARS_HH_
\ No newline at end of file
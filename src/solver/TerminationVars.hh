@@ -0,0 +1,20 @@
+#ifndef SOLVER_TERMINATIONVARS_HH_
+#define SOLVER_TERMINATIONVARS_HH_
+
+#include <optional>
+
+struct TerminationVars {
+    // Wall-clock budget of the run, in seconds. 0 means no limit.
+    double                timeLimit;
+    // Stop as soon as the best fitness reaches this, if set.
+    std::optional<double> targetFitness;
+    // Stop after this many generations without a new best. 0 means never.
+    int                   maxStaleGenerations;
+    // Stop once the best finishes the craft at the quality cap. Past that
+    // point only a shorter sequence could still score higher.
+    bool                  stopAtMaxQuality;
+    // Report every new best as soon as it is found, with the time it took.
+    bool                  anytime;
+};
+
+#endif  // SOLVER_TERMINATIONVARS_HH_
@@ -0,0 +1,81 @@
+#ifndef SOLVER_TRANSPOSITIONTABLE_HH_
+#define SOLVER_TRANSPOSITIONTABLE_HH_
+
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
+#include "../model/StateKey.hh"
+
+// Thread-safe map from canonical state keys to the best outcome known for that
+// state, so that search engines can skip states they already expanded through
+// another ordering of the same actions.
+//
+// The table is split in shards, each behind its own lock, so that concurrent
+// workers rarely contend.
+template <typename Outcome>
+class TranspositionTable {
+   public:
+    // Records the outcome for this key unless an outcome at least as good is
+    // already known. Returns whether the table was updated. The comparator
+    // returns true when its first argument is at least as good as the second.
+    // Of equally good outcomes, the first recorded stays: callers that need the
+    // same result on every run have to call this in a fixed order.
+    template <typename AtLeastAsGood>
+    bool improve(const StateKey& key, const Outcome& outcome,
+                 AtLeastAsGood atLeastAsGood) {
+        size_t hash = key.hash();
+        Shard& shard = _shards[hash % SHARD_COUNT];
+
+        std::lock_guard lock(shard.mutex);
+        auto [it, inserted] = shard.entries.try_emplace(key, outcome);
+        if (inserted) {
+            return true;
+        }
+        if (atLeastAsGood(it->second, outcome)) {
+            return false;
+        }
+        it->second = outcome;
+        return true;
+    }
+
+    bool lookup(const StateKey& key, Outcome& outcome) const {
+        const Shard& shard = _shards[key.hash() % SHARD_COUNT];
+
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+        outcome = it->second;
+        return true;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const Shard& shard : _shards) {
+            std::lock_guard lock(shard.mutex);
+            n += shard.entries.size();
+        }
+        return n;
+    }
+
+    void clear() {
+        for (Shard& shard : _shards) {
+            std::lock_guard lock(shard.mutex);
+            shard.entries.clear();
+        }
+    }
+
+   private:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    struct Shard {
+        mutable std::mutex                                    mutex;
+        std::unordered_map<StateKey, Outcome, StateKey::Hash> entries;
+    };
+
+    std::array<Shard, SHARD_COUNT> _shards;
+};
+
+#endif  // SOLVER_TRANSPOSITIONTABLE_HH_
@@ -0,0 +1,87 @@
+#include "BatchSolver.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <numeric>
+
+#include "../Solver.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+
+BatchSolver::BatchSolver(ThreadPool& pool, int maxJobs)
+    : _pool(pool), _maxJobs(maxJobs) {}
+
+std::vector<BatchResult> BatchSolver::run(const std::vector<BatchJob>& jobs,
+                                          const ResultCallback&        onResult) {
+    std::vector<int> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&jobs](int i, int j) {
+        return jobs[i].priority > jobs[j].priority;
+    });
+
+    std::vector<BatchResult> results(jobs.size());
+    std::mutex               resultMutex;
+    std::atomic<int>         next(0);
+
+    // Every runner works through the queue one job at a time, so the number of
+    // runners is the number of jobs in flight.
+    int runners = std::min<int>(jobs.size(), _pool.concurrency(_maxJobs));
+
+    _pool.parallelFor(runners, runners, [&](int) {
+        int i;
+        while ((i = next.fetch_add(1)) < order.size()) {
+            BatchResult result = solve(order[i], jobs[order[i]]);
+
+            std::lock_guard lock(resultMutex);
+            if (onResult) {
+                onResult(result);
+            }
+            results[result.job] = std::move(result);
+        }
+    });
+
+    return results;
+}
+
+BatchResult BatchSolver::solve(int index, const BatchJob& job) {
+    TraceSpan span("job", "job", index);
+
+    BatchResult result{};
+    result.job = index;
+    result.name = job.name;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    SolverSettings settings(job.settings);
+    settings.quiet = true;
+    settings.debug = false;
+
+    try {
+        Solver solver(settings, _pool);
+        if (!settings.cache.path.empty()) {
+            solver.setSolutionCache(cache(settings.cache.path));
+        }
+        solver.solve();
+        result.best = solver.best();
+        result.stats = solver.stats();
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+SolutionCache& BatchSolver::cache(const std::string& path) {
+    std::lock_guard lock(_cacheMutex);
+
+    std::unique_ptr<SolutionCache>& cache = _caches[path];
+    if (!cache) {
+        cache = std::make_unique<SolutionCache>(path);
+    }
+    return *cache;
+}
@@ -0,0 +1,65 @@
+#ifndef SOLVER_BATCH_BATCHSOLVER_HH_
+#define SOLVER_BATCH_BATCHSOLVER_HH_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Individual.hh"
+#include "../SolverSettings.hh"
+#include "../cache/SolutionCache.hh"
+#include "../montecarlo/MonteCarloStats.hh"
+
+class ThreadPool;
+
+struct BatchJob {
+    std::string    name;
+    SolverSettings settings;
+    // Jobs with a higher priority start first, equal ones in list order.
+    int priority;
+};
+
+struct BatchResult {
+    // Index of the job in the list given to BatchSolver::run().
+    int             job;
+    std::string     name;
+    Individual      best;
+    MonteCarloStats stats;
+    double          seconds;
+    // Empty unless the job failed.
+    std::string error;
+};
+
+// Solves many recipe/crafter combinations on one shared thread pool. At most
+// maxJobs jobs run at once and each uses at most settings.threads of the pool
+// (0: all of it) for its own parallel work. Jobs naming the same solution cache
+// share one instance of it. Jobs run quietly; their results are reported as they
+// finish instead.
+class BatchSolver {
+   public:
+    using ResultCallback = std::function<void(const BatchResult& result)>;
+
+    // A maxJobs of 0 runs as many jobs at once as the pool has threads.
+    BatchSolver(ThreadPool& pool, int maxJobs);
+
+    // Blocks until every job is done and returns the results in job order.
+    // onResult, if set, is called for each result as soon as its job finishes,
+    // never concurrently.
+    std::vector<BatchResult> run(const std::vector<BatchJob>& jobs,
+                                 const ResultCallback&        onResult);
+
+   private:
+    BatchResult    solve(int index, const BatchJob& job);
+    SolutionCache& cache(const std::string& path);
+
+    ThreadPool& _pool;
+    int         _maxJobs;
+
+    std::map<std::string, std::unique_ptr<SolutionCache>> _caches;
+    std::mutex                                            _cacheMutex;
+};
+
+#endif  // SOLVER_BATCH_BATCHSOLVER_HH_
@@ -0,0 +1,229 @@
+#include "BeamSearch.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <unordered_map>
+
+#include "../../actions/Action.hh"
+#include "../../actions/ActionTable.hh"
+#include "../../model/Crafter.hh"
+#include "../../model/Recipe.hh"
+#include "../../model/Synth.hh"
+#include "../Solver.hh"
+#include "../SolverSettings.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+
+BeamSearch::BeamSearch(const SolverSettings& settings, ThreadPool& pool,
+                       const std::atomic<bool>* stop)
+    : settings(settings), _pool(pool), _stop(stop) {}
+
+Individual BeamSearch::search(const Synth& synth) {
+    int beamWidth = settings.beam.beamWidth > 0 ? settings.beam.beamWidth : 1000;
+    int maxDepth = settings.beam.maxDepth;
+    if (maxDepth <= 0) {
+        maxDepth = synth.maxLength > 0 ? synth.maxLength : 30;
+    }
+
+    Individual best;
+    best.fitness.fitness = std::numeric_limits<double>::lowest();
+
+    _transpositions.clear();
+
+    State             root(synth);
+    std::vector<Node> beam{{root, root.key(), {}, 0.0}};
+    std::vector<Node> children;
+
+    if (!settings.quiet) {
+        printf("\n");
+    }
+
+    for (int depth = 1; depth <= maxDepth && !beam.empty(); ++depth) {
+        if (_stop != nullptr && *_stop) {
+            break;
+        }
+        expand(synth, beam, children, best);
+
+        int expanded = children.size();
+        prune(children);
+        int nonDominated = children.size();
+
+        if (children.size() > beamWidth) {
+            std::nth_element(
+                children.begin(), children.begin() + beamWidth, children.end(),
+                [](const Node& x, const Node& y) { return x.score > y.score; });
+            children.erase(children.begin() + beamWidth, children.end());
+        }
+
+        std::swap(beam, children);
+
+        if (settings.quiet) {
+            continue;
+        }
+
+        if (settings.debug) {
+            printf(
+                "Depth [%d]: %d expanded, %d non-dominated, %d kept, best fitness = "
+                "[%.1f, %.1f, %.1f, %d]\n",
+                depth, expanded, nonDominated, static_cast<int>(beam.size()),
+                best.fitness.fitness, best.fitness.fitnessProg, best.fitness.cpState,
+                best.fitness.length);
+        } else {
+            printf("Depth %2d/%2d -=- Beam: %5d - Best fitness: %.1f\r", depth, maxDepth,
+                   static_cast<int>(beam.size()), best.fitness.fitness);
+            fflush(stdout);
+        }
+    }
+
+    if (!settings.debug && !settings.quiet) {
+        printf("\n");
+    }
+
+    return best;
+}
+
+void BeamSearch::expand(const Synth& synth, const std::vector<Node>& beam,
+                        std::vector<Node>& children, Individual& best) {
+    const std::vector<ActionId>& actions = settings.crafter.actions;
+    const double penaltyWeight = settings.solver.penaltyWeight;
+
+    // Split the beam in more chunks than threads to even out the load.
+    int threads = _pool.concurrency(settings.threads);
+    int nChunks = std::min<int>(beam.size(), 4 * threads);
+
+    // The table is only read while the chunks run, so what they make does not
+    // depend on which thread gets where first.
+    std::vector<std::vector<Child>> chunkChildren(nChunks);
+
+    _pool.parallelFor(nChunks, threads, [&](int chunk) {
+        TraceSpan span("beam batch", "chunk", chunk);
+
+        int begin = chunk * beam.size() / nChunks;
+        int end = (chunk + 1) * beam.size() / nChunks;
+
+        for (int i = begin; i < end; ++i) {
+            const Node& node = beam[i];
+
+            for (const ActionId actionId : actions) {
+                State child(node.state);
+                _simSynth.step(child, actionId, false);
+
+                // Actions that had no effect never lead anywhere new,
+                // and running out of CP is never recoverable.
+                if (child.wastedActions() >= node.state.wastedActions() + 1 ||
+                    child.cp() < 0) {
+                    continue;
+                }
+
+                // Reordering independent buffs reaches the same state
+                // many times over; only expand it once.
+                StateKey key = child.key();
+                Cost     cost{child.wastedActions(), child.step()};
+                Cost     known;
+                if (_transpositions.lookup(key, known) && atLeastAsCheap(known, cost)) {
+                    continue;
+                }
+
+                ActionSequence sequence(node.sequence);
+                sequence.push_back(actionId);
+
+                Fitness fitness =
+                    Solver::evalState(child, synth, penaltyWeight, sequence.size());
+                bool   terminal = isTerminal(child);
+                double childScore = terminal ? 0.0 : score(child);
+                chunkChildren[chunk].push_back(
+                    {{std::move(child), key, std::move(sequence), childScore},
+                     cost,
+                     fitness,
+                     terminal});
+            }
+        }
+    });
+
+    // States reached as cheaply twice at this depth are kept for the first
+    // node of the beam that reached them.
+    children.clear();
+    for (std::vector<Child>& chunk : chunkChildren) {
+        for (Child& child : chunk) {
+            if (!_transpositions.improve(child.node.key, child.cost, atLeastAsCheap)) {
+                continue;
+            }
+            if (child.fitness > best.fitness) {
+                best.sequence = child.node.sequence;
+                best.fitness = child.fitness;
+            }
+            if (!child.terminal) {
+                children.push_back(std::move(child.node));
+            }
+        }
+    }
+}
+
+void BeamSearch::prune(std::vector<Node>& children) const {
+    std::unordered_map<StateKey, std::vector<int>, StateKey::EffectsHash,
+                       StateKey::EffectsEqual>
+        groups;
+
+    for (int i = 0; i < children.size(); ++i) {
+        groups[children[i].key].push_back(i);
+    }
+
+    std::vector<Node> survivors;
+    survivors.reserve(children.size());
+
+    for (auto& [key, group] : groups) {
+        // Visiting the best scores first means that most dominated states are
+        // rejected by one of the first few survivors.
+        std::sort(group.begin(), group.end(), [&children](int i, int j) {
+            return children[i].score > children[j].score;
+        });
+
+        int groupBegin = survivors.size();
+        for (int i : group) {
+            bool dominated = false;
+            for (int j = groupBegin; j < survivors.size() && !dominated; ++j) {
+                dominated = dominates(survivors[j].state, children[i].state);
+            }
+            if (!dominated) {
+                survivors.push_back(std::move(children[i]));
+            }
+        }
+    }
+
+    std::swap(children, survivors);
+}
+
+bool BeamSearch::isTerminal(const State& state) const {
+    return state.progress() >= state.synthesis().recipe.difficulty ||
+           state.durability() <= 0;
+}
+
+double BeamSearch::score(const State& state) const {
+    const Synth& synth = state.synthesis();
+
+    double maxQuality = synth.recipe.maxQuality * (1 + synth.recipe.safetyMargin * 0.01);
+    double quality = synth.solverVars.solveForCompletion
+                       ? 0.0
+                       : std::min(state.quality(), maxQuality) / maxQuality;
+    double progress =
+        std::min(state.progress(), double(synth.recipe.difficulty)) /
+        synth.recipe.difficulty;
+
+    // Leftover resources are what later steps turn into quality and progress,
+    // so they are worth a fraction of a finished craft.
+    double resources = state.cp() / synth.crafter.craftingPoints +
+                       state.durability() / synth.recipe.durability;
+
+    return quality + progress + 0.2 * resources - 0.01 * state.wastedActions();
+}
+
+bool BeamSearch::atLeastAsCheap(const Cost& known, const Cost& cost) {
+    return known.wastedActions <= cost.wastedActions && known.step <= cost.step;
+}
+
+bool BeamSearch::dominates(const State& a, const State& b) {
+    return a.progress() >= b.progress() && a.quality() >= b.quality() &&
+           a.cp() >= b.cp() && a.durability() >= b.durability() &&
+           a.wastedActions() <= b.wastedActions() && a.step() <= b.step();
+}
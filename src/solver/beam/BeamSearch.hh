@@ -0,0 +1,71 @@
+#ifndef SOLVER_BEAM_BEAMSEARCH_HH_
+#define SOLVER_BEAM_BEAMSEARCH_HH_
+
+#include <atomic>
+#include <vector>
+
+#include "../../model/State.hh"
+#include "../../model/StateKey.hh"
+#include "../Individual.hh"
+#include "../TranspositionTable.hh"
+#include "../simulation/SimSynth.hh"
+
+class SolverSettings;
+class Synth;
+class ThreadPool;
+
+// Breadth-first search over action sequences which only keeps the most promising
+// states at every depth. States that reach the same effects are compared on their
+// resources and the dominated ones are dropped before the beam is cut. States that
+// were already reached more cheaply, at this depth or an earlier one, are skipped.
+// The result doesn't depend on the number of threads.
+class BeamSearch {
+   public:
+    // Once stop is set, search() returns the best macro found so far at the end of
+    // the current depth.
+    BeamSearch(const SolverSettings& settings, ThreadPool& pool,
+               const std::atomic<bool>* stop = nullptr);
+
+    Individual search(const Synth& synth);
+
+   private:
+    struct Node {
+        State          state;
+        StateKey       key;
+        ActionSequence sequence;
+        double         score;
+    };
+
+    // What it took to reach a state; less is better on both counts.
+    struct Cost {
+        double wastedActions;
+        int    step;
+    };
+
+    // A node expanded, before the transposition table has had its say.
+    struct Child {
+        Node    node;
+        Cost    cost;
+        Fitness fitness;
+        bool    terminal;
+    };
+
+    void expand(const Synth& synth, const std::vector<Node>& beam,
+                std::vector<Node>& children, Individual& best);
+    void prune(std::vector<Node>& children) const;
+
+    bool   isTerminal(const State& state) const;
+    double score(const State& state) const;
+
+    static bool atLeastAsCheap(const Cost& known, const Cost& cost);
+    static bool dominates(const State& a, const State& b);
+
+    const SolverSettings&    settings;
+    ThreadPool&              _pool;
+    const std::atomic<bool>* _stop;
+
+    SimSynth                 _simSynth;
+    TranspositionTable<Cost> _transpositions;
+};
+
+#endif  // SOLVER_BEAM_BEAMSEARCH_HH_
@@ -0,0 +1,11 @@
+#ifndef SOLVER_BEAM_BEAMSEARCHVARS_HH_
+#define SOLVER_BEAM_BEAMSEARCHVARS_HH_
+
+struct BeamSearchVars {
+    int beamWidth;
+    // Maximum sequence length explored. 0 uses the synth's maxLength if set,
+    // otherwise 30 steps.
+    int maxDepth;
+};
+
+#endif  // SOLVER_BEAM_BEAMSEARCHVARS_HH_
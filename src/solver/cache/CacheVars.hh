@@ -0,0 +1,19 @@
+#ifndef SOLVER_CACHE_CACHEVARS_HH_
+#define SOLVER_CACHE_CACHEVARS_HH_
+
+#include <string>
+
+struct CacheVars {
+    // Solution store shared between runs. Empty disables the cache.
+    std::string path;
+    // Return a stored solution instead of searching. Without it, the cache only
+    // records new solutions.
+    bool lookup;
+    // Share of every subpopulation of the genetic engine seeded with the
+    // solutions of the most similar cached crafts. 0 disables seeding.
+    double seedFraction;
+    // Number of similar crafts to seed from.
+    int seedNeighbours;
+};
+
+#endif  // SOLVER_CACHE_CACHEVARS_HH_
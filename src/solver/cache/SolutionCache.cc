@@ -0,0 +1,525 @@
+#include "SolutionCache.hh"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../SolverSettings.hh"
+#include "../io/BinaryIO.hh"
+
+namespace {
+
+constexpr char     DATA_MAGIC[8] = {'F', 'F', 'X', 'I', 'V', 'S', 'O', 'L'};
+constexpr char     INDEX_MAGIC[8] = {'F', 'F', 'X', 'I', 'V', 'I', 'D', 'X'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t   DATA_HEADER_SIZE = sizeof(DATA_MAGIC) + 4;
+// Record size and checksum, ahead of every record.
+constexpr size_t   RECORD_HEADER_SIZE = 8;
+constexpr uint32_t MAX_RECORD_SIZE = 1 << 20;
+constexpr uint32_t MIN_INDEX_CAPACITY = 64;
+
+uint32_t fnv1a32(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Holds flock() on a file for as long as it lives, which serializes the
+// processes sharing the cache.
+class FileLock {
+   public:
+    FileLock(int fd, int operation) : _fd(fd) { flock(_fd, operation); }
+    ~FileLock() { flock(_fd, LOCK_UN); }
+
+    // Changes the kind of lock held. The lock may be let go of in between, so
+    // what it guards has to be checked again afterwards.
+    void relock(int operation) { flock(_fd, operation); }
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+   private:
+    int _fd;
+};
+
+bool readAt(int fd, char* out, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, out, size, offset);
+        if (n <= 0) {
+            return false;
+        }
+        out += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool writeAt(int fd, const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+uint64_t fileSize(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw std::runtime_error("Could not stat the solution cache.");
+    }
+    return st.st_size;
+}
+
+}  // namespace
+
+uint64_t SolutionCache::key(const SolverSettings& settings) {
+    const Recipe&  recipe = settings.recipe;
+    const Crafter& crafter = settings.crafter;
+
+    BinaryWriter w;
+    w.u32(VERSION);
+
+    for (int x : {recipe.baseLevel, recipe.level, recipe.difficulty, recipe.durability,
+                  recipe.startQuality, recipe.safetyMargin, recipe.maxQuality,
+                  recipe.suggestedCraftsmanship, recipe.suggestedControl,
+                  recipe.progressDivider, recipe.progressModifier,
+                  recipe.qualityDivider, recipe.qualityModifier, recipe.stars}) {
+        w.i32(x);
+    }
+
+    w.i32(crafter.cls);
+    w.i32(crafter.level);
+    w.i32(crafter.craftsmanship);
+    w.i32(crafter.control);
+    w.i32(crafter.craftingPoints);
+    w.u8(crafter.isSpecialist);
+
+    // The order actions are listed in doesn't matter.
+    std::vector<ActionId> actions(crafter.actions);
+    std::sort(actions.begin(), actions.end());
+    actions.erase(std::unique(actions.begin(), actions.end()), actions.end());
+    w.sequence(actions);
+
+    w.i32(settings.maxTrickUses);
+    w.i32(settings.reliabilityPercent);
+    w.i32(settings.maxLength);
+    w.u8(settings.useConditions);
+    w.f64(settings.solver.penaltyWeight);
+    w.u8(settings.solver.solveForCompletion);
+    w.f64(settings.solver.remainerCPFitnessValue);
+    w.f64(settings.solver.remainerDuraFitnessValue);
+
+    return w.hash();
+}
+
+SolutionCache::Features SolutionCache::features(const SolverSettings& settings) {
+    return {
+        double(settings.recipe.level),
+        double(settings.recipe.difficulty),
+        double(settings.recipe.durability),
+        double(settings.recipe.maxQuality),
+        double(settings.crafter.level),
+        double(settings.crafter.craftsmanship),
+        double(settings.crafter.control),
+        double(settings.crafter.craftingPoints),
+    };
+}
+
+SolutionCache::SolutionCache(const std::string& path)
+    : _path(path),
+      _dataFd(-1),
+      _indexFd(-1),
+      _indexInode(0),
+      _header(nullptr),
+      _slots(nullptr),
+      _mappedSize(0) {
+    _dataFd = open(_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_dataFd < 0) {
+        throw std::runtime_error("Could not open solution cache " + _path);
+    }
+
+    FileLock lock(_dataFd, LOCK_EX);
+
+    if (fileSize(_dataFd) == 0) {
+        BinaryWriter w;
+        w.bytes(DATA_MAGIC, sizeof(DATA_MAGIC));
+        w.u32(VERSION);
+        if (!writeAt(_dataFd, w.data().data(), w.data().size(), 0)) {
+            throw std::runtime_error("Could not write solution cache " + _path);
+        }
+    } else {
+        char header[DATA_HEADER_SIZE];
+        if (!readAt(_dataFd, header, sizeof(header), 0) ||
+            std::memcmp(header, DATA_MAGIC, sizeof(DATA_MAGIC)) != 0 ||
+            BinaryReader(header + sizeof(DATA_MAGIC), 4).u32() != VERSION) {
+            throw std::runtime_error(_path + " is not a solution cache of this version.");
+        }
+    }
+
+    openIndex();
+}
+
+SolutionCache::~SolutionCache() {
+    unmapIndex();
+    if (_dataFd >= 0) {
+        close(_dataFd);
+    }
+}
+
+std::optional<SolutionCache::Entry> SolutionCache::find(uint64_t key) {
+    std::lock_guard lock(_mutex);
+    FileLock        fileLock(_dataFd, LOCK_SH);
+    if (indexStale()) {
+        fileLock.relock(LOCK_EX);
+        reloadIfReplaced();
+    }
+
+    const IndexSlot* slot = probe(key);
+    if (slot->offset == 0) {
+        return std::nullopt;
+    }
+    return readRecord(slot->offset);
+}
+
+bool SolutionCache::store(uint64_t key, const Entry& entry) {
+    std::lock_guard lock(_mutex);
+    FileLock        fileLock(_dataFd, LOCK_EX);
+    reloadIfReplaced();
+
+    IndexSlot* slot = probe(key);
+    if (slot->offset != 0 && !(entry.fitness > readRecord(slot->offset).fitness)) {
+        return false;
+    }
+
+    BinaryWriter payload;
+    payload.u64(key);
+    payload.u32(entry.features.size());
+    for (double x : entry.features) {
+        payload.f64(x);
+    }
+    payload.fitness(entry.fitness);
+    payload.sequence(entry.sequence);
+
+    BinaryWriter record;
+    record.u32(payload.data().size());
+    record.u32(fnv1a32(payload.data().data(), payload.data().size()));
+    record.bytes(payload.data().data(), payload.data().size());
+
+    uint64_t offset = _header->dataSize;
+    if (!writeAt(_dataFd, record.data().data(), record.data().size(), offset)) {
+        throw std::runtime_error("Could not append to solution cache " + _path);
+    }
+    uint64_t dataSize = offset + record.data().size();
+
+    if (slot->offset != 0) {
+        slot->offset = offset;
+        _header->dataSize = dataSize;
+    } else if (2 * (_header->count + 1) <= _header->capacity) {
+        slot->key = key;
+        slot->offset = offset;
+        _header->count += 1;
+        _header->dataSize = dataSize;
+    } else {
+        // Keep the table at most half full, so that probes stay short.
+        std::vector<IndexSlot> slots{{key, offset}};
+        for (uint32_t i = 0; i < _header->capacity; ++i) {
+            if (_slots[i].offset != 0) {
+                slots.push_back(_slots[i]);
+            }
+        }
+        buildIndex(slots, 2 * _header->capacity, dataSize);
+    }
+
+    return true;
+}
+
+std::vector<SolutionCache::Entry> SolutionCache::nearest(const Features& features,
+                                                         int             k) {
+    std::lock_guard lock(_mutex);
+    FileLock        fileLock(_dataFd, LOCK_SH);
+    if (indexStale()) {
+        fileLock.relock(LOCK_EX);
+        reloadIfReplaced();
+    }
+
+    // One read of the whole file beats a read per record.
+    std::vector<char> data(_header->dataSize);
+    if (!readAt(_dataFd, data.data(), data.size(), 0)) {
+        throw std::runtime_error("Could not read solution cache " + _path);
+    }
+
+    std::vector<std::pair<double, Entry>> candidates;
+    for (uint32_t i = 0; i < _header->capacity; ++i) {
+        if (_slots[i].offset == 0) {
+            continue;
+        }
+
+        const char* record = data.data() + _slots[i].offset;
+        uint32_t    recordSize = BinaryReader(record, RECORD_HEADER_SIZE).u32();
+        Entry       entry = parseRecord(record + RECORD_HEADER_SIZE, recordSize);
+
+        double distance = 0;
+        for (int f = 0; f < features.size(); ++f) {
+            double d = (entry.features[f] - features[f]) /
+                       std::max(std::abs(features[f]), 1.0);
+            distance += d * d;
+        }
+        candidates.emplace_back(distance, std::move(entry));
+    }
+
+    k = std::min<int>(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                      [](const auto& x, const auto& y) { return x.first < y.first; });
+
+    std::vector<Entry> entries;
+    for (int i = 0; i < k; ++i) {
+        entries.push_back(std::move(candidates[i].second));
+    }
+    return entries;
+}
+
+int SolutionCache::size() {
+    std::lock_guard lock(_mutex);
+    FileLock        fileLock(_dataFd, LOCK_SH);
+    if (indexStale()) {
+        fileLock.relock(LOCK_EX);
+        reloadIfReplaced();
+    }
+    return _header->count;
+}
+
+void SolutionCache::openIndex() {
+    mapIndex();
+
+    bool valid = _header != nullptr && std::memcmp(_header->magic, INDEX_MAGIC,
+                                                   sizeof(INDEX_MAGIC)) == 0 &&
+                 _header->version == VERSION && _header->capacity > 0 &&
+                 (_header->capacity & (_header->capacity - 1)) == 0 &&
+                 _mappedSize == sizeof(IndexHeader) +
+                                    size_t(_header->capacity) * sizeof(IndexSlot) &&
+                 _header->dataSize == fileSize(_dataFd);
+    if (valid) {
+        return;
+    }
+
+    std::vector<IndexSlot> slots;
+    for (const auto& [key, record] : scanData()) {
+        slots.push_back({key, record.first});
+    }
+
+    uint32_t capacity = MIN_INDEX_CAPACITY;
+    while (capacity < 2 * slots.size()) {
+        capacity *= 2;
+    }
+    buildIndex(slots, capacity, fileSize(_dataFd));
+}
+
+void SolutionCache::buildIndex(const std::vector<IndexSlot>& slots, uint32_t capacity,
+                               uint64_t dataSize) {
+    // Build the new table aside and move it in place, so that other processes
+    // never see it half done.
+    std::string tmpPath = indexPath() + ".tmp";
+    size_t      size = sizeof(IndexHeader) + size_t(capacity) * sizeof(IndexSlot);
+
+    int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("Could not write solution cache index " + tmpPath);
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Could not map solution cache index " + tmpPath);
+    }
+
+    // A fresh file reads as zeros, which are empty slots.
+    auto* header = static_cast<IndexHeader*>(memory);
+    auto* table = reinterpret_cast<IndexSlot*>(header + 1);
+    std::memcpy(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header->version = VERSION;
+    header->capacity = capacity;
+    header->count = slots.size();
+    header->dataSize = dataSize;
+
+    for (const IndexSlot& slot : slots) {
+        uint32_t i = slot.key & (capacity - 1);
+        while (table[i].offset != 0) {
+            i = (i + 1) & (capacity - 1);
+        }
+        table[i] = slot;
+    }
+    munmap(memory, size);
+
+    if (std::rename(tmpPath.c_str(), indexPath().c_str()) != 0) {
+        throw std::runtime_error("Could not move solution cache index to " + indexPath());
+    }
+    mapIndex();
+    if (_header == nullptr) {
+        throw std::runtime_error("Could not map solution cache index " + indexPath());
+    }
+}
+
+void SolutionCache::mapIndex() {
+    unmapIndex();
+
+    _indexFd = open(indexPath().c_str(), O_RDWR | O_CLOEXEC);
+    if (_indexFd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(_indexFd, &st) != 0 || size_t(st.st_size) < sizeof(IndexHeader)) {
+        return;
+    }
+    void* memory =
+        mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, _indexFd, 0);
+    if (memory == MAP_FAILED) {
+        return;
+    }
+
+    _indexInode = st.st_ino;
+    _mappedSize = st.st_size;
+    _header = static_cast<IndexHeader*>(memory);
+    _slots = reinterpret_cast<IndexSlot*>(_header + 1);
+}
+
+void SolutionCache::unmapIndex() {
+    if (_header != nullptr) {
+        munmap(_header, _mappedSize);
+    }
+    if (_indexFd >= 0) {
+        close(_indexFd);
+    }
+    _indexFd = -1;
+    _indexInode = 0;
+    _header = nullptr;
+    _slots = nullptr;
+    _mappedSize = 0;
+}
+
+bool SolutionCache::indexStale() const {
+    // Another process may have grown the index, which replaces the file.
+    struct stat st;
+    return stat(indexPath().c_str(), &st) != 0 || st.st_ino != _indexInode ||
+           _header->dataSize != fileSize(_dataFd);
+}
+
+void SolutionCache::reloadIfReplaced() {
+    if (indexStale()) {
+        openIndex();
+    }
+}
+
+SolutionCache::Scan SolutionCache::scanData() {
+    uint64_t          size = fileSize(_dataFd);
+    std::vector<char> data(size - DATA_HEADER_SIZE);
+    if (!readAt(_dataFd, data.data(), data.size(), DATA_HEADER_SIZE)) {
+        throw std::runtime_error("Could not read solution cache " + _path);
+    }
+
+    Scan   records;
+    size_t offset = 0;
+    while (data.size() - offset >= RECORD_HEADER_SIZE) {
+        BinaryReader header(data.data() + offset, RECORD_HEADER_SIZE);
+        uint32_t     recordSize = header.u32();
+        uint32_t     checksum = header.u32();
+
+        const char* payload = data.data() + offset + RECORD_HEADER_SIZE;
+        if (recordSize > data.size() - offset - RECORD_HEADER_SIZE ||
+            fnv1a32(payload, recordSize) != checksum) {
+            break;
+        }
+
+        BinaryReader r(payload, recordSize);
+        uint64_t     key = r.u64();
+        for (size_t n = r.count(8); n > 0; --n) {
+            r.f64();
+        }
+        Fitness fitness = r.fitness();
+
+        // Later records of a key only get written when they are better.
+        auto it = records.find(key);
+        if (it == records.end() || !(it->second.second > fitness)) {
+            records[key] = {DATA_HEADER_SIZE + offset, fitness};
+        }
+        offset += RECORD_HEADER_SIZE + recordSize;
+    }
+
+    // Drop what a crash left of an unfinished append.
+    if (offset != data.size()) {
+        fprintf(stderr, "Dropping %zu damaged bytes at the end of %s\n",
+                data.size() - offset, _path.c_str());
+        if (ftruncate(_dataFd, DATA_HEADER_SIZE + offset) != 0) {
+            throw std::runtime_error("Could not repair solution cache " + _path);
+        }
+    }
+
+    return records;
+}
+
+SolutionCache::IndexSlot* SolutionCache::probe(uint64_t key) const {
+    uint32_t mask = _header->capacity - 1;
+    uint32_t i = key & mask;
+    while (_slots[i].offset != 0 && _slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return &_slots[i];
+}
+
+SolutionCache::Entry SolutionCache::readRecord(uint64_t offset) const {
+    char header[RECORD_HEADER_SIZE];
+    if (!readAt(_dataFd, header, sizeof(header), offset)) {
+        throw std::runtime_error("Could not read solution cache " + _path);
+    }
+    BinaryReader headerReader(header, sizeof(header));
+    uint32_t     recordSize = headerReader.u32();
+    uint32_t     checksum = headerReader.u32();
+    if (recordSize > MAX_RECORD_SIZE) {
+        throw std::runtime_error("Damaged record in solution cache " + _path);
+    }
+
+    std::vector<char> payload(recordSize);
+    if (!readAt(_dataFd, payload.data(), payload.size(), offset + sizeof(header)) ||
+        fnv1a32(payload.data(), payload.size()) != checksum) {
+        throw std::runtime_error("Damaged record in solution cache " + _path);
+    }
+
+    return parseRecord(payload.data(), payload.size());
+}
+
+SolutionCache::Entry SolutionCache::parseRecord(const char* payload, size_t size) {
+    BinaryReader r(payload, size);
+    Entry        entry{};
+    r.u64();  // key
+    size_t nFeatures = r.count(8);
+    for (size_t i = 0; i < nFeatures; ++i) {
+        double x = r.f64();
+        if (i < entry.features.size()) {
+            entry.features[i] = x;
+        }
+    }
+    entry.fitness = r.fitness();
+    entry.sequence = r.sequence();
+    return entry;
+}
+
+std::string SolutionCache::indexPath() const { return _path + ".idx"; }
@@ -0,0 +1,111 @@
+#ifndef SOLVER_CACHE_SOLUTIONCACHE_HH_
+#define SOLVER_CACHE_SOLUTIONCACHE_HH_
+
+#include <sys/types.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Fitness.hh"
+#include "../Individual.hh"
+
+class SolverSettings;
+
+// Best known solutions, kept across runs and processes.
+//
+// Solutions are appended to a data file and never rewritten. A memory-mapped
+// open-addressing table next to it, at path + ".idx", maps every key to the
+// offset of its best solution. The index holds nothing that isn't in the data
+// file, so it is rebuilt whenever it is missing or out of date.
+class SolutionCache {
+   public:
+    // What a solution was solved for, for finding solutions of similar crafts:
+    // recipe level, difficulty, durability, max quality, crafter level,
+    // craftsmanship, control and CP.
+    using Features = std::array<double, 8>;
+
+    struct Entry {
+        Features       features;
+        Fitness        fitness;
+        ActionSequence sequence;
+    };
+
+    // Hash of everything that decides what the best solution is: the recipe, the
+    // crafter's stats and actions, and the settings that shape the fitness.
+    // Settings that only steer the search are left out.
+    static uint64_t key(const SolverSettings& settings);
+    static Features features(const SolverSettings& settings);
+
+    // Throws std::runtime_error if the files can't be opened or aren't a cache.
+    explicit SolutionCache(const std::string& path);
+    ~SolutionCache();
+
+    SolutionCache(const SolutionCache&) = delete;
+    SolutionCache& operator=(const SolutionCache&) = delete;
+
+    std::optional<Entry> find(uint64_t key);
+
+    // Appends the entry unless the cache already has one for the key that is at
+    // least as good. Returns whether it was stored.
+    bool store(uint64_t key, const Entry& entry);
+
+    // The best solutions of the k crafts with the nearest features, nearest
+    // first. Features are compared relative to their size, so that a point of
+    // CP counts as much as a point of difficulty of the same proportion.
+    std::vector<Entry> nearest(const Features& features, int k);
+
+    int size();
+
+   private:
+    struct IndexHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t capacity;
+        uint64_t count;
+        // Bytes of the data file covered by the index.
+        uint64_t dataSize;
+    };
+
+    struct IndexSlot {
+        uint64_t key;
+        // 0 for an empty slot; records never start there.
+        uint64_t offset;
+    };
+
+    // Latest best record of each key found when scanning the data file.
+    using Scan = std::unordered_map<uint64_t, std::pair<uint64_t, Fitness>>;
+
+    void openIndex();
+    void buildIndex(const std::vector<IndexSlot>& slots, uint32_t capacity,
+                    uint64_t dataSize);
+    void mapIndex();
+    void unmapIndex();
+    // Readers only hold a shared lock on the data file. Reloading may repair
+    // the data and rebuild the index, which takes an exclusive one.
+    bool indexStale() const;
+    void reloadIfReplaced();
+
+    Scan         scanData();
+    IndexSlot*   probe(uint64_t key) const;
+    Entry        readRecord(uint64_t offset) const;
+    static Entry parseRecord(const char* payload, size_t size);
+    std::string  indexPath() const;
+
+    std::string _path;
+    int         _dataFd;
+    int         _indexFd;
+    ino_t       _indexInode;
+
+    IndexHeader* _header;
+    IndexSlot*   _slots;
+    size_t       _mappedSize;
+
+    std::mutex _mutex;
+};
+
+#endif  // SOLVER_CACHE_SOLUTIONCACHE_HH_
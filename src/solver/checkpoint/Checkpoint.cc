@@ -0,0 +1,231 @@
+#include "Checkpoint.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "../SolverSettings.hh"
+#include "../cache/SolutionCache.hh"
+#include "../io/BinaryIO.hh"
+#include "../profile/Trace.hh"
+
+namespace {
+
+constexpr char MAGIC[8] = {'F', 'F', 'X', 'I', 'V', 'C', 'K', 'P'};
+
+constexpr size_t MIN_INDIVIDUAL_SIZE = 4 + 3 * 8 + 4;
+constexpr size_t OPERATOR_STATS_SIZE = GENETIC_OPERATOR_COUNT * 4 * 8;
+
+}  // namespace
+
+uint64_t Checkpoint::fingerprint(const SolverSettings& settings) {
+    BinaryWriter w;
+    w.u64(SolutionCache::key(settings));
+
+    // How many generations to run, and when to stop, may change on resuming.
+    const SolverVars& solver = settings.solver;
+    w.i32(solver.population);
+    w.i32(solver.subPopulations);
+    w.i32(solver.maxStagnationCounter);
+    w.f64(solver.probCrossover);
+    w.f64(solver.probMutation);
+    w.i32(solver.maxSubSeqLength);
+    w.u8(solver.eliminateDuplicates);
+
+    const OperatorVars& operators = settings.operators;
+    w.u8(operators.adaptive);
+    w.f64(operators.learningRate);
+    w.f64(operators.adaptationRate);
+    w.f64(operators.minProbability);
+
+    w.i32(settings.polish.maxEdits);
+    w.i32(settings.polish.eliteInterval);
+    return w.hash();
+}
+
+std::vector<char> Checkpoint::serialize() const {
+    BinaryWriter w;
+    w.bytes(MAGIC, sizeof(MAGIC));
+    w.u32(VERSION);
+    w.u64(settingsFingerprint);
+
+    w.i32(generation);
+    w.i32(staleGenerations);
+    w.i32(subPopulations);
+    w.u64(evaluations);
+
+    w.u32(population.size());
+    for (const Individual& ind : population) {
+        w.individual(ind);
+    }
+    w.individual(best);
+    w.fitness(lastBest);
+
+    w.u32(lastFitnesses.size());
+    for (double x : lastFitnesses) {
+        w.f64(x);
+    }
+    w.u32(stagnationCounter.size());
+    for (int x : stagnationCounter) {
+        w.i32(x);
+    }
+    w.u32(lastLeaderboard.size());
+    for (int x : lastLeaderboard) {
+        w.i32(x);
+    }
+    w.u32(operatorStats.size());
+    for (const auto& stats : operatorStats) {
+        for (const OperatorStats& op : stats) {
+            w.u64(op.applied);
+            w.u64(op.successes);
+            w.f64(op.quality);
+            w.f64(op.probability);
+        }
+    }
+
+    w.u32(rngState.size());
+    w.bytes(rngState.data(), rngState.size());
+
+    return std::move(w.data());
+}
+
+Checkpoint Checkpoint::deserialize(const std::vector<char>& data) {
+    BinaryReader r(data);
+
+    char magic[sizeof(MAGIC)];
+    r.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a checkpoint file.");
+    }
+    if (r.u32() != VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version.");
+    }
+
+    Checkpoint c;
+    c.settingsFingerprint = r.u64();
+    c.generation = r.i32();
+    c.staleGenerations = r.i32();
+    c.subPopulations = r.i32();
+    c.evaluations = r.u64();
+
+    c.population.resize(r.count(MIN_INDIVIDUAL_SIZE));
+    for (auto& ind : c.population) {
+        ind = r.individual();
+    }
+    c.best = r.individual();
+    c.lastBest = r.fitness();
+
+    c.lastFitnesses.resize(r.count(8));
+    for (auto& x : c.lastFitnesses) {
+        x = r.f64();
+    }
+    c.stagnationCounter.resize(r.count(4));
+    for (auto& x : c.stagnationCounter) {
+        x = r.i32();
+    }
+    c.lastLeaderboard.resize(r.count(4));
+    for (auto& x : c.lastLeaderboard) {
+        x = r.i32();
+    }
+    c.operatorStats.resize(r.count(OPERATOR_STATS_SIZE));
+    for (auto& stats : c.operatorStats) {
+        for (OperatorStats& op : stats) {
+            op.applied = r.u64();
+            op.successes = r.u64();
+            op.quality = r.f64();
+            op.probability = r.f64();
+        }
+    }
+
+    c.rngState.resize(r.count(1));
+    r.bytes(c.rngState.data(), c.rngState.size());
+
+    if (!r.atEnd()) {
+        throw std::runtime_error("Checkpoint has trailing data.");
+    }
+    if (c.subPopulations <= 0 || c.lastFitnesses.size() != c.subPopulations ||
+        c.stagnationCounter.size() != c.subPopulations ||
+        c.lastLeaderboard.size() != c.subPopulations ||
+        c.operatorStats.size() != c.subPopulations) {
+        throw std::runtime_error("Checkpoint subpopulation state is inconsistent.");
+    }
+    for (int subpop : c.lastLeaderboard) {
+        if (subpop < 0 || subpop >= c.subPopulations) {
+            throw std::runtime_error("Checkpoint subpopulation state is inconsistent.");
+        }
+    }
+
+    return c;
+}
+
+std::optional<Checkpoint> Checkpoint::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    return deserialize(data);
+}
+
+CheckpointWriter::CheckpointWriter(std::string path)
+    : _path(std::move(path)),
+      _stopping(false),
+      _thread(&CheckpointWriter::writerLoop, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void CheckpointWriter::write(Checkpoint checkpoint) {
+    {
+        std::lock_guard lock(_mutex);
+        _pending = std::move(checkpoint);
+    }
+    _cv.notify_one();
+}
+
+void CheckpointWriter::writerLoop() {
+    while (true) {
+        std::optional<Checkpoint> checkpoint;
+        {
+            std::unique_lock lock(_mutex);
+            _cv.wait(lock, [this] { return _stopping || _pending.has_value(); });
+            if (!_pending) {
+                return;
+            }
+            checkpoint = std::move(_pending);
+            _pending.reset();
+        }
+        save(*checkpoint);
+    }
+}
+
+void CheckpointWriter::save(const Checkpoint& checkpoint) const {
+    TraceSpan span("checkpoint write", "generation", checkpoint.generation);
+
+    std::vector<char> data = checkpoint.serialize();
+
+    // Write next to the target and rename over it, so that a crash mid-write
+    // leaves the previous checkpoint intact.
+    std::string tmpPath = _path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), data.size());
+        if (!file) {
+            fprintf(stderr, "Could not write checkpoint to %s\n", tmpPath.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), _path.c_str()) != 0) {
+        fprintf(stderr, "Could not move checkpoint to %s\n", _path.c_str());
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SOLVER_CHECKPOINT_CHECKPOINT_HH_
+#define SOLVER_CHECKPOINT_CHECKPOINT_HH_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Individual.hh"
+#include "../operators/AdaptivePursuit.hh"
+
+struct SolverSettings;
+
+// Everything the genetic engine needs to carry on exactly where it stopped.
+//
+// On disk: an 8 byte magic and a version, then little-endian fixed-size fields.
+// Sequences take one byte per action.
+struct Checkpoint {
+    static constexpr uint32_t VERSION = 4;
+
+    // Hash of the craft and of the settings the run's state depends on. A run
+    // only resumes from a checkpoint with its own fingerprint.
+    static uint64_t fingerprint(const SolverSettings& settings);
+
+    uint64_t settingsFingerprint;
+
+    int      generation;
+    int      staleGenerations;
+    int      subPopulations;
+    // Sequences evaluated by the run so far.
+    uint64_t evaluations;
+
+    std::vector<Individual> population;
+    Individual              best;
+    Fitness                 lastBest;
+    std::vector<double>     lastFitnesses;
+    std::vector<int>        stagnationCounter;
+    std::vector<int>        lastLeaderboard;
+
+    // Each subpopulation's operator stats and mutation odds.
+    std::vector<std::array<OperatorStats, GENETIC_OPERATOR_COUNT>> operatorStats;
+
+    // The solver's std::mt19937, as written by its operator<<.
+    std::string rngState;
+
+    std::vector<char> serialize() const;
+
+    // Throws std::runtime_error on malformed or incompatible data.
+    static Checkpoint deserialize(const std::vector<char>& data);
+
+    // Empty if the file can't be opened.
+    static std::optional<Checkpoint> load(const std::string& path);
+};
+
+// Saves checkpoints from a thread of its own, so that the solver only pays for
+// copying its state. If checkpoints come in faster than they can be written,
+// only the latest one is kept. The destructor waits for it to be on disk.
+class CheckpointWriter {
+   public:
+    explicit CheckpointWriter(std::string path);
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void write(Checkpoint checkpoint);
+
+   private:
+    void writerLoop();
+    void save(const Checkpoint& checkpoint) const;
+
+    std::string               _path;
+    std::optional<Checkpoint> _pending;
+    std::mutex                _mutex;
+    std::condition_variable   _cv;
+    bool                      _stopping;
+    std::thread               _thread;
+};
+
+#endif  // SOLVER_CHECKPOINT_CHECKPOINT_HH_
@@ -0,0 +1,15 @@
+#ifndef SOLVER_CHECKPOINT_CHECKPOINTVARS_HH_
+#define SOLVER_CHECKPOINT_CHECKPOINTVARS_HH_
+
+#include <string>
+
+struct CheckpointVars {
+    // File the genetic engine's state is saved to. Empty disables checkpoints.
+    std::string path;
+    // Generations between two checkpoints. The last generation is always saved.
+    int         interval;
+    // Continue from the checkpoint in `path` if there is one.
+    bool        resume;
+};
+
+#endif  // SOLVER_CHECKPOINT_CHECKPOINTVARS_HH_
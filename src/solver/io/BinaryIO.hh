@@ -0,0 +1,170 @@
+#ifndef SOLVER_IO_BINARYIO_HH_
+#define SOLVER_IO_BINARYIO_HH_
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../Individual.hh"
+
+// Little-endian encoding of fixed-size fields, for the files the solver keeps
+// between runs.
+class BinaryWriter {
+   public:
+    void u8(uint8_t x) { _data.push_back(static_cast<char>(x)); }
+
+    void u32(uint32_t x) {
+        for (int i = 0; i < 4; ++i) {
+            u8(x >> (8 * i));
+        }
+    }
+
+    void u64(uint64_t x) {
+        for (int i = 0; i < 8; ++i) {
+            u8(x >> (8 * i));
+        }
+    }
+
+    void i32(int x) { u32(static_cast<uint32_t>(x)); }
+
+    void f64(double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        u64(bits);
+    }
+
+    void bytes(const char* data, size_t size) {
+        _data.insert(_data.end(), data, data + size);
+    }
+
+    void fitness(const Fitness& f) {
+        f64(f.fitness);
+        f64(f.fitnessProg);
+        f64(f.cpState);
+        i32(f.length);
+    }
+
+    // One byte per action.
+    void sequence(const ActionSequence& sequence) {
+        u32(sequence.size());
+        for (const ActionId actionId : sequence) {
+            u8(actionId);
+        }
+    }
+
+    void individual(const Individual& ind) {
+        sequence(ind.sequence);
+        fitness(ind.fitness);
+    }
+
+    // FNV-1a of everything written so far.
+    uint64_t hash() const {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : _data) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::vector<char>& data() { return _data; }
+
+   private:
+    std::vector<char> _data;
+};
+
+// Reads what BinaryWriter wrote. Throws std::runtime_error when the data ends
+// early or holds an unknown action.
+class BinaryReader {
+   public:
+    BinaryReader(const char* data, size_t size) : _data(data), _size(size), _offset(0) {}
+    explicit BinaryReader(const std::vector<char>& data)
+        : BinaryReader(data.data(), data.size()) {}
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(_data[_offset++]);
+    }
+
+    uint32_t u32() {
+        uint32_t x = 0;
+        for (int i = 0; i < 4; ++i) {
+            x |= uint32_t(u8()) << (8 * i);
+        }
+        return x;
+    }
+
+    uint64_t u64() {
+        uint64_t x = 0;
+        for (int i = 0; i < 8; ++i) {
+            x |= uint64_t(u8()) << (8 * i);
+        }
+        return x;
+    }
+
+    int i32() { return static_cast<int>(u32()); }
+
+    double f64() {
+        uint64_t bits = u64();
+        double   x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    // A count of items that each take at least itemSize more bytes.
+    size_t count(size_t itemSize) {
+        size_t n = u32();
+        need(n * itemSize);
+        return n;
+    }
+
+    void bytes(char* out, size_t size) {
+        need(size);
+        std::memcpy(out, _data + _offset, size);
+        _offset += size;
+    }
+
+    Fitness fitness() {
+        Fitness f;
+        f.fitness = f64();
+        f.fitnessProg = f64();
+        f.cpState = f64();
+        f.length = i32();
+        return f;
+    }
+
+    ActionSequence sequence() {
+        ActionSequence sequence(count(1));
+        for (auto& actionId : sequence) {
+            uint8_t id = u8();
+            if (id >= ActionCount) {
+                throw std::runtime_error("Unknown action in binary data.");
+            }
+            actionId = static_cast<ActionId>(id);
+        }
+        return sequence;
+    }
+
+    Individual individual() {
+        Individual ind(sequence());
+        ind.fitness = fitness();
+        return ind;
+    }
+
+    size_t offset() const { return _offset; }
+    bool   atEnd() const { return _offset == _size; }
+
+   private:
+    void need(size_t size) const {
+        if (size > _size - _offset) {
+            throw std::runtime_error("Unexpected end of binary data.");
+        }
+    }
+
+    const char* _data;
+    size_t      _size;
+    size_t      _offset;
+};
+
+#endif  // SOLVER_IO_BINARYIO_HH_
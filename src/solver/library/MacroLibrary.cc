@@ -0,0 +1,342 @@
+#include "MacroLibrary.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "../../actions/ActionTable.hh"
+#include "../../model/State.hh"
+#include "../../model/Synth.hh"
+#include "../io/BinaryIO.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+#include "../simulation/SimSynth.hh"
+
+namespace {
+
+constexpr char     MAGIC[8] = {'F', 'F', 'X', 'I', 'V', 'L', 'I', 'B'};
+constexpr uint32_t VERSION = 1;
+
+// Stats are searched up to here. Macros that need more are not kept.
+constexpr int MAX_STAT = 1 << 16;
+
+// Least value in [low, high] for which feasible holds, high + 1 if there is
+// none. Feasibility has to be monotone in the value.
+template <typename Feasible>
+int leastFeasible(int low, int high, const Feasible& feasible) {
+    int end = high + 1;
+    while (low < end) {
+        int mid = low + (end - low) / 2;
+        if (feasible(mid)) {
+            end = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return end;
+}
+
+// Everything a saved library has to agree on with the one loading it.
+std::vector<int> libraryKey(const SolverSettings& settings, int targetQuality) {
+    const Recipe& recipe = settings.recipe;
+    return {recipe.baseLevel,
+            recipe.level,
+            recipe.difficulty,
+            recipe.durability,
+            recipe.startQuality,
+            recipe.safetyMargin,
+            recipe.maxQuality,
+            recipe.suggestedCraftsmanship,
+            recipe.suggestedControl,
+            recipe.progressDivider,
+            recipe.progressModifier,
+            recipe.qualityDivider,
+            recipe.qualityModifier,
+            recipe.stars,
+            settings.crafter.level,
+            settings.maxTrickUses,
+            settings.useConditions,
+            targetQuality};
+}
+
+}  // namespace
+
+MacroLibrary::MacroLibrary(const SolverSettings& settings, int targetQuality)
+    : _settings(settings), _targetQuality(targetQuality) {}
+
+int MacroLibrary::add(ThreadPool& pool, const std::vector<ActionSequence>& macros) {
+    // Macros already kept, or given twice, are only measured once.
+    std::vector<const ActionSequence*> fresh;
+    for (const ActionSequence& macro : macros) {
+        if (_known.insert(macro).second) {
+            fresh.push_back(&macro);
+        }
+    }
+
+    std::vector<std::optional<LibraryEntry>> measured(fresh.size());
+    pool.parallelFor(fresh.size(), [&](int i) {
+        TraceSpan span("measure", "macro", i);
+        measured[i] = measure(*fresh[i]);
+    });
+
+    int added = 0;
+    for (auto& entry : measured) {
+        if (entry) {
+            append(std::move(*entry));
+            ++added;
+        }
+    }
+    buildIndex();
+    return added;
+}
+
+const LibraryEntry* MacroLibrary::best(const Crafter& crafter) const {
+    if (crafter.level != _settings.crafter.level) {
+        return nullptr;
+    }
+
+    std::bitset<ACTION_COUNT> actions;
+    for (ActionId actionId : crafter.actions) {
+        actions.set(actionId);
+    }
+
+    int best = -1;
+    search(0, _order.size(), crafter, actions, best);
+    return best >= 0 ? &_entries[best] : nullptr;
+}
+
+int MacroLibrary::size() const { return _entries.size(); }
+
+const LibraryEntry& MacroLibrary::entry(int index) const { return _entries[index]; }
+
+void MacroLibrary::save(const std::string& path) const {
+    BinaryWriter w;
+    w.bytes(MAGIC, sizeof(MAGIC));
+    w.u32(VERSION);
+    for (int x : libraryKey(_settings, _targetQuality)) {
+        w.i32(x);
+    }
+
+    w.u32(_entries.size());
+    for (const LibraryEntry& entry : _entries) {
+        w.sequence(entry.sequence);
+        for (int stat : entry.minStats) {
+            w.i32(stat);
+        }
+        w.i32(entry.maxCraftsmanship);
+    }
+
+    // Written next to the target and renamed over it, as checkpoints are.
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(w.data().data(), w.data().size());
+        if (!file) {
+            throw std::runtime_error("Could not write macro library to " + tmpPath);
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not move macro library to " + path);
+    }
+}
+
+void MacroLibrary::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open macro library " + path);
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    BinaryReader r(data);
+    char         magic[sizeof(MAGIC)];
+    r.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || r.u32() != VERSION) {
+        throw std::runtime_error(path + " is not a macro library");
+    }
+    for (int x : libraryKey(_settings, _targetQuality)) {
+        if (r.i32() != x) {
+            throw std::runtime_error(path + " holds macros for another craft");
+        }
+    }
+
+    // Sequence size and four stats.
+    size_t                    count = r.count(4 + 4 * 4);
+    std::vector<LibraryEntry> entries(count);
+    for (LibraryEntry& entry : entries) {
+        entry.sequence = r.sequence();
+        for (int& stat : entry.minStats) {
+            stat = r.i32();
+        }
+        entry.maxCraftsmanship = r.i32();
+    }
+    if (!r.atEnd()) {
+        throw std::runtime_error(path + " has trailing data");
+    }
+
+    for (LibraryEntry& entry : entries) {
+        if (_known.insert(entry.sequence).second) {
+            append(std::move(entry));
+        }
+    }
+    buildIndex();
+}
+
+std::optional<LibraryEntry> MacroLibrary::measure(const ActionSequence& macro) const {
+    if (macro.empty()) {
+        return std::nullopt;
+    }
+
+    SimSynth simSynth;
+    Crafter  crafter(_settings.crafter);
+    struct Outcome {
+        bool   finished;
+        double quality, cp, durability;
+    };
+    auto play = [&](int craftsmanship, int control, int craftingPoints) {
+        crafter.craftsmanship = craftsmanship;
+        crafter.control = control;
+        crafter.craftingPoints = craftingPoints;
+        Synth synth(crafter, _settings.recipe, _settings.maxTrickUses,
+                    _settings.reliabilityPercent / 100.0, _settings.useConditions,
+                    _settings.maxLength, _settings.solver);
+
+        State s = simSynth.execute(macro, State(synth), false, false, false);
+        bool  progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
+        s.checkViolations(progressOk, cpOk, durabilityOk, trickOk, reliabilityOk);
+        return Outcome{progressOk && cpOk && durabilityOk, s.quality(), s.cp(),
+                       s.durability()};
+    };
+
+    LibraryEntry entry{.sequence = macro};
+    int&         craftsmanship = entry.minStats[0];
+    int&         control = entry.minStats[1];
+    int&         craftingPoints = entry.minStats[2];
+
+    craftsmanship = leastFeasible(
+        0, MAX_STAT, [&](int x) { return play(x, MAX_STAT, MAX_STAT).finished; });
+    if (craftsmanship > MAX_STAT) {
+        return std::nullopt;
+    }
+
+    // More craftsmanship finishes the craft sooner, and the actions after that are
+    // never played. Up to the point where that happens the same actions are
+    // played, so the other stats needed stay the same.
+    Outcome least = play(craftsmanship, MAX_STAT, MAX_STAT);
+    entry.maxCraftsmanship =
+        leastFeasible(craftsmanship + 1, MAX_STAT, [&](int x) {
+            Outcome o = play(x, MAX_STAT, MAX_STAT);
+            return o.quality != least.quality || o.cp != least.cp ||
+                   o.durability != least.durability;
+        }) -
+        1;
+
+    craftingPoints = leastFeasible(0, MAX_STAT, [&](int x) {
+        return play(craftsmanship, MAX_STAT, x).finished;
+    });
+    control = leastFeasible(0, MAX_STAT, [&](int x) {
+        return play(craftsmanship, x, craftingPoints).quality >= _targetQuality;
+    });
+    if (craftingPoints > MAX_STAT || control > MAX_STAT) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+void MacroLibrary::append(LibraryEntry entry) {
+    std::bitset<ACTION_COUNT> actions;
+    int                       steps = 0;
+    for (ActionId actionId : entry.sequence) {
+        const Action& action = ALL_ACTIONS[actionId];
+        actions.set(actionId);
+        steps += action.isCombo ? action.comboActions.size() : 1;
+    }
+
+    _entries.push_back(std::move(entry));
+    _actions.push_back(actions);
+    _steps.push_back(steps);
+}
+
+void MacroLibrary::buildIndex() {
+    const int n = _entries.size();
+    _order.resize(n);
+    for (int i = 0; i < n; ++i) {
+        _order[i] = i;
+    }
+    _low.resize(n);
+    _highCraftsmanship.resize(n);
+    _best.resize(n);
+
+    // Splits on the stats in turn, then fills in the subtrees bottom up.
+    auto build = [&](auto& self, int begin, int end, int depth) -> void {
+        if (begin >= end) {
+            return;
+        }
+        const int mid = begin + (end - begin) / 2;
+        const int stat = depth % 3;
+        std::nth_element(_order.begin() + begin, _order.begin() + mid,
+                         _order.begin() + end, [&](int a, int b) {
+                             return _entries[a].minStats[stat] <
+                                    _entries[b].minStats[stat];
+                         });
+        self(self, begin, mid, depth + 1);
+        self(self, mid + 1, end, depth + 1);
+
+        const LibraryEntry& entry = _entries[_order[mid]];
+        _low[mid] = entry.minStats;
+        _highCraftsmanship[mid] = entry.maxCraftsmanship;
+        _best[mid] = _order[mid];
+        auto merge = [&](int childBegin, int childEnd) {
+            if (childBegin >= childEnd) {
+                return;
+            }
+            const int child = childBegin + (childEnd - childBegin) / 2;
+            for (int s = 0; s < 3; ++s) {
+                _low[mid][s] = std::min(_low[mid][s], _low[child][s]);
+            }
+            _highCraftsmanship[mid] =
+                std::max(_highCraftsmanship[mid], _highCraftsmanship[child]);
+            if (better(_best[child], _best[mid])) {
+                _best[mid] = _best[child];
+            }
+        };
+        merge(begin, mid);
+        merge(mid + 1, end);
+    };
+    build(build, 0, n, 0);
+}
+
+bool MacroLibrary::better(int a, int b) const {
+    return _steps[a] < _steps[b] || (_steps[a] == _steps[b] && a < b);
+}
+
+void MacroLibrary::search(int begin, int end, const Crafter& crafter,
+                          const std::bitset<ACTION_COUNT>& actions, int& best) const {
+    if (begin >= end) {
+        return;
+    }
+    const int mid = begin + (end - begin) / 2;
+
+    // Nothing in the subtree is good enough or usable with these stats.
+    const std::array<int, 3>& low = _low[mid];
+    if ((best >= 0 && !better(_best[mid], best)) || low[0] > crafter.craftsmanship ||
+        low[1] > crafter.control || low[2] > crafter.craftingPoints ||
+        _highCraftsmanship[mid] < crafter.craftsmanship) {
+        return;
+    }
+
+    const int           i = _order[mid];
+    const LibraryEntry& entry = _entries[i];
+    if (entry.minStats[0] <= crafter.craftsmanship &&
+        entry.maxCraftsmanship >= crafter.craftsmanship &&
+        entry.minStats[1] <= crafter.control &&
+        entry.minStats[2] <= crafter.craftingPoints &&
+        (_actions[i] & ~actions).none() && (best < 0 || better(i, best))) {
+        best = i;
+    }
+    search(begin, mid, crafter, actions, best);
+    search(mid + 1, end, crafter, actions, best);
+}
@@ -0,0 +1,84 @@
+#ifndef SOLVER_LIBRARY_MACROLIBRARY_HH_
+#define SOLVER_LIBRARY_MACROLIBRARY_HH_
+
+#include <array>
+#include <bitset>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../../model/Crafter.hh"
+#include "../Individual.hh"
+#include "../SolverSettings.hh"
+
+class ThreadPool;
+
+struct LibraryEntry {
+    ActionSequence     sequence;
+    // Least craftsmanship, control and CP the macro needs.
+    std::array<int, 3> minStats;
+    // Most craftsmanship before the craft finishes early and cuts actions off.
+    int                maxCraftsmanship;
+};
+
+// Known macros for one recipe, looked up by what a crafter can do with them.
+//
+// A macro is feasible for a crafter when it finishes the craft within CP and
+// durability, with at least the target quality, when simulated with expected
+// values. Progress only depends on craftsmanship, quality on control and
+// neither on CP, so what a macro needs is a box of stats: found once per
+// macro by binary searching each stat, and kept in a k-d tree. Finding the
+// best macro a crafter can use then takes no simulation at all.
+class MacroLibrary {
+   public:
+    // Macros are kept for the recipe and rules of settings and crafters of its
+    // crafter's level.
+    MacroLibrary(const SolverSettings& settings, int targetQuality);
+
+    // Works out what each macro needs, spread over the pool, and keeps those
+    // that reach the target quality with some stats. Returns how many were kept.
+    // Macros the library has seen before are skipped.
+    int add(ThreadPool& pool, const std::vector<ActionSequence>& macros);
+
+    // The feasible macro with the fewest steps, of equal ones the first added.
+    // nullptr if there is none, or if the crafter is of another level.
+    const LibraryEntry* best(const Crafter& crafter) const;
+
+    int                 size() const;
+    const LibraryEntry& entry(int index) const;
+
+    // Adds the macros of a library saved for the same recipe, rules, level and
+    // target quality. Both throw std::runtime_error on bad or unreadable files.
+    void save(const std::string& path) const;
+    void load(const std::string& path);
+
+   private:
+    std::optional<LibraryEntry> measure(const ActionSequence& macro) const;
+    void                        append(LibraryEntry entry);
+    void                        buildIndex();
+    bool                        better(int a, int b) const;
+    void search(int begin, int end, const Crafter& crafter,
+                const std::bitset<ACTION_COUNT>& actions, int& best) const;
+
+    SolverSettings _settings;
+    int            _targetQuality;
+
+    std::vector<LibraryEntry>              _entries;
+    std::vector<std::bitset<ACTION_COUNT>> _actions;
+    std::vector<int>                       _steps;
+    // Every macro measured, kept or not.
+    std::set<ActionSequence>               _known;
+
+    // The k-d tree is _order itself: the entry at the middle of a range splits
+    // it, and the halves are its subtrees. For the subtree rooted at position i,
+    // _low[i] holds the least stats and _highCraftsmanship[i] the most
+    // craftsmanship any of its macros allow, _best[i] its best macro.
+    std::vector<int>                _order;
+    std::vector<std::array<int, 3>> _low;
+    std::vector<int>                _highCraftsmanship;
+    std::vector<int>                _best;
+};
+
+#endif  // SOLVER_LIBRARY_MACROLIBRARY_HH_
@@ -0,0 +1,17 @@
+#ifndef SOLVER_MCTS_MCTSVARS_HH_
+#define SOLVER_MCTS_MCTSVARS_HH_
+
+struct MctsVars {
+    // Total number of playouts, shared by all threads.
+    int    iterations;
+    // UCT exploration constant. 0 uses sqrt(2).
+    double exploration;
+    // Memory reserved for the tree. 0 uses 256 MB.
+    int    maxMemoryMB;
+    // Decisions taken fewer times than this are left out of the policy.
+    int    minPolicyVisits;
+    // Resource buckets per dimension of the policy table. 0 uses 8.
+    int    policyBuckets;
+};
+
+#endif  // SOLVER_MCTS_MCTSVARS_HH_
@@ -0,0 +1,359 @@
+#include "MonteCarloTreeSearch.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+#include "../../actions/Action.hh"
+#include "../../actions/ActionTable.hh"
+#include "../../model/Crafter.hh"
+#include "../../model/Recipe.hh"
+#include "../../model/Synth.hh"
+#include "../SolverSettings.hh"
+#include "../montecarlo/MonteCarloSim.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+
+MonteCarloTreeSearch::MonteCarloTreeSearch(const SolverSettings&    settings,
+                                           ThreadPool&              pool,
+                                           const std::atomic<bool>* stop)
+    : settings(settings),
+      _pool(pool),
+      _stop(stop),
+      _maxDepth(0),
+      _exploration(settings.mcts.exploration > 0 ? settings.mcts.exploration
+                                                 : std::sqrt(2.0)),
+      _nodeCapacity(0),
+      _edgeCapacity(0),
+      _nodeCount(0),
+      _edgeCount(0) {}
+
+Policy MonteCarloTreeSearch::search(const Synth&          synth,
+                                    const ActionSequence& rolloutSequence) {
+    int iterations = settings.mcts.iterations > 0 ? settings.mcts.iterations : 100000;
+    _maxDepth = synth.maxLength > 0 ? synth.maxLength : 30;
+
+    // Split the memory budget so that every node could be fully expanded.
+    size_t budget = size_t(settings.mcts.maxMemoryMB > 0 ? settings.mcts.maxMemoryMB
+                                                         : 256)
+                  << 20;
+    size_t nodeSize = sizeof(Node) + settings.crafter.actions.size() * sizeof(Edge);
+    _nodeCapacity = std::max<size_t>(1, budget / nodeSize);
+    _edgeCapacity = _nodeCapacity * settings.crafter.actions.size();
+    _nodes = std::make_unique<Node[]>(_nodeCapacity);
+    _edges = std::make_unique<Edge[]>(_edgeCapacity);
+    _nodeCount = 0;
+    _edgeCount = 0;
+
+    newNode(State(synth).key(), 0);
+
+    std::atomic<int> started(0);
+    std::atomic<int> finished(0);
+
+    if (!settings.quiet) {
+        printf("\n");
+    }
+
+    int threads = _pool.concurrency(settings.threads);
+    _pool.parallelFor(threads, settings.threads, [&](int worker) {
+        TraceSpan                        span("playouts", "worker", worker);
+        MonteCarloSim                    sim;
+        std::vector<std::pair<int, int>> path;
+
+        while (!(_stop != nullptr && *_stop) && started.fetch_add(1) < iterations) {
+            playout(synth, sim, rolloutSequence, path);
+
+            int done = finished.fetch_add(1) + 1;
+            if (!settings.debug && !settings.quiet && done % 1000 == 0) {
+                printf("Playout %7d/%7d -=- Nodes: %7d/%7d\r", done, iterations,
+                       std::min(_nodeCount.load(), _nodeCapacity), _nodeCapacity);
+                fflush(stdout);
+            }
+        }
+    });
+
+    Policy policy = extractPolicy(rolloutSequence);
+
+    if (!settings.quiet) {
+        printf("\nTree search: %d playouts, %d nodes, policy covers %d states.\n",
+               finished.load(), std::min(_nodeCount.load(), _nodeCapacity),
+               static_cast<int>(policy.entries.size()));
+    }
+
+    if (settings.debug && !settings.quiet) {
+        for (const PolicyEntry& entry : policy.entries) {
+            if (entry.key.condition != Normal) {
+                printf("  Step %2d on %-9s: %-25s (%d visits, value %.3f)\n",
+                       entry.step + 1, condition2str(entry.key.condition),
+                       ALL_ACTIONS[entry.action].fullName, entry.visits, entry.value);
+            }
+        }
+    }
+
+    return policy;
+}
+
+void MonteCarloTreeSearch::playout(const Synth& synth, MonteCarloSim& sim,
+                                   const ActionSequence&             rolloutSequence,
+                                   std::vector<std::pair<int, int>>& path) {
+    State s(synth);
+    int   nodeIndex = 0;
+    int   depth = 0;
+    int   position = 0;
+
+    path.clear();
+
+    // Selection and expansion: walk down the tree until a new node was added,
+    // the craft is over or the pools are exhausted.
+    while (nodeIndex >= 0 && !isTerminal(s, depth)) {
+        Node& node = _nodes[nodeIndex];
+        int   edgeIndex;
+        {
+            std::lock_guard lock(node.mutex);
+            if (node.firstEdge < 0 && !expand(node, s)) {
+                break;
+            }
+            edgeIndex = select(node);
+            _edges[edgeIndex].virtualLoss += 1;
+        }
+
+        ActionId action = _edges[edgeIndex].action;
+        path.push_back({nodeIndex, edgeIndex});
+        applyAction(sim, s, action);
+        depth++;
+        if (position < rolloutSequence.size() && action == rolloutSequence[position]) {
+            position++;
+        }
+
+        bool created;
+        nodeIndex = child(node, edgeIndex, s.key(), position, created);
+        if (created) {
+            break;
+        }
+    }
+
+    rollout(sim, s, depth, position, rolloutSequence);
+    backpropagate(path, reward(s));
+}
+
+bool MonteCarloTreeSearch::expand(Node& node, const State& state) {
+    int count = 0;
+    for (const ActionId actionId : settings.crafter.actions) {
+        count += ALL_ACTIONS[actionId].isUsable(state.condition());
+    }
+
+    if (count == 0) {
+        return false;
+    }
+
+    int first = _edgeCount.fetch_add(count);
+    if (first + count > _edgeCapacity) {
+        return false;
+    }
+
+    int i = first;
+    for (const ActionId actionId : settings.crafter.actions) {
+        if (ALL_ACTIONS[actionId].isUsable(state.condition())) {
+            _edges[i++] = {actionId, 0, 0, -1, 0.0};
+        }
+    }
+
+    node.firstEdge = first;
+    node.edgeCount = count;
+    return true;
+}
+
+int MonteCarloTreeSearch::select(const Node& node) const {
+    // UCT, where edges being explored by other threads count as visits that
+    // returned nothing.
+    double logVisits = std::log(node.visits + 1);
+    double bestValue = -1;
+    int    bestEdge = node.firstEdge;
+
+    for (int i = node.firstEdge; i < node.firstEdge + node.edgeCount; ++i) {
+        const Edge& edge = _edges[i];
+        int         n = edge.visits + edge.virtualLoss;
+        if (n == 0) {
+            return i;
+        }
+        double value = edge.valueSum / n + _exploration * std::sqrt(logVisits / n);
+        if (value > bestValue) {
+            bestValue = value;
+            bestEdge = i;
+        }
+    }
+    return bestEdge;
+}
+
+int MonteCarloTreeSearch::child(Node& node, int edgeIndex, const StateKey& key,
+                                int position, bool& created) {
+    std::lock_guard lock(node.mutex);
+
+    created = false;
+    Edge& edge = _edges[edgeIndex];
+    for (int i = edge.firstChild; i >= 0; i = _nodes[i].nextSibling) {
+        if (_nodes[i].key == key && _nodes[i].position == position) {
+            return i;
+        }
+    }
+
+    int index = newNode(key, position);
+    if (index >= 0) {
+        _nodes[index].nextSibling = edge.firstChild;
+        edge.firstChild = index;
+        created = true;
+    }
+    return index;
+}
+
+int MonteCarloTreeSearch::newNode(const StateKey& key, int position) {
+    int index = _nodeCount.fetch_add(1);
+    if (index >= _nodeCapacity) {
+        return -1;
+    }
+
+    Node& node = _nodes[index];
+    node.key = key;
+    node.position = position;
+    node.visits = 0;
+    node.firstEdge = -1;
+    node.edgeCount = 0;
+    node.nextSibling = -1;
+    return index;
+}
+
+void MonteCarloTreeSearch::rollout(MonteCarloSim& sim, State& state, int depth,
+                                   int                   position,
+                                   const ActionSequence& rolloutSequence) const {
+    for (int i = position; i < rolloutSequence.size() && !isTerminal(state, depth);
+         ++i) {
+        if (ALL_ACTIONS[rolloutSequence[i]].isUsable(state.condition())) {
+            applyAction(sim, state, rolloutSequence[i]);
+            depth++;
+        }
+    }
+}
+
+void MonteCarloTreeSearch::backpropagate(const std::vector<std::pair<int, int>>& path,
+                                         double reward) {
+    for (const auto& [nodeIndex, edgeIndex] : path) {
+        Node& node = _nodes[nodeIndex];
+        Edge& edge = _edges[edgeIndex];
+
+        std::lock_guard lock(node.mutex);
+        node.visits += 1;
+        edge.visits += 1;
+        edge.virtualLoss -= 1;
+        edge.valueSum += reward;
+    }
+}
+
+void MonteCarloTreeSearch::applyAction(MonteCarloSim& sim, State& state,
+                                       ActionId actionId) const {
+    const Action& action = ALL_ACTIONS[actionId];
+    if (action.isCombo) {
+        for (const auto& comboActionId : action.comboActions) {
+            state = sim.step(state, ALL_ACTIONS[comboActionId], false, false, false);
+        }
+    } else {
+        state = sim.step(state, action, false, false, false);
+    }
+}
+
+bool MonteCarloTreeSearch::isTerminal(const State& state, int depth) const {
+    return depth >= _maxDepth ||
+           state.progress() >= state.synthesis().recipe.difficulty ||
+           state.durability() <= 0 || state.cp() < 0;
+}
+
+double MonteCarloTreeSearch::reward(const State& state) const {
+    bool progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
+    state.checkViolations(progressOk, cpOk, durabilityOk, trickOk, reliabilityOk);
+
+    if (!progressOk || !cpOk || !durabilityOk) {
+        return 0.0;
+    }
+
+    const Synth& synth = state.synthesis();
+    if (synth.solverVars.solveForCompletion) {
+        return 1.0;
+    }
+
+    // A finished craft is always worth more than a failed one.
+    double maxQuality = synth.recipe.maxQuality * (1 + synth.recipe.safetyMargin * 0.01);
+    return 0.1 + 0.9 * std::min(state.quality(), maxQuality) / maxQuality;
+}
+
+Policy MonteCarloTreeSearch::extractPolicy(const ActionSequence& rolloutSequence) const {
+    Policy policy;
+    int    minVisits = std::max(1, settings.mcts.minPolicyVisits);
+    int    nodeCount = std::min(_nodeCount.load(), _nodeCapacity);
+
+    // Most visited action, ties going to the best mean reward.
+    const auto bestEdge = [this](const Node& node) {
+        int best = node.firstEdge;
+        for (int i = node.firstEdge; i < node.firstEdge + node.edgeCount; ++i) {
+            const Edge& edge = _edges[i];
+            if (edge.visits > _edges[best].visits ||
+                (edge.visits == _edges[best].visits && edge.visits > 0 &&
+                 edge.valueSum > _edges[best].valueSum)) {
+                best = i;
+            }
+        }
+        return best;
+    };
+
+    // Principal line: most visited action, then most likely outcome, and the
+    // rest of the rollout sequence once it leaves the tree.
+    int rolloutPosition = 0;
+    for (int nodeIndex = 0; nodeIndex >= 0;) {
+        const Node& node = _nodes[nodeIndex];
+        rolloutPosition = node.position;
+        if (node.firstEdge < 0 || node.visits == 0) {
+            break;
+        }
+
+        const Edge& edge = _edges[bestEdge(node)];
+        policy.principal.push_back(edge.action);
+
+        nodeIndex = -1;
+        int childVisits = 0;
+        for (int c = edge.firstChild; c >= 0; c = _nodes[c].nextSibling) {
+            if (_nodes[c].visits > childVisits) {
+                childVisits = _nodes[c].visits;
+                nodeIndex = c;
+            }
+        }
+    }
+
+    for (int i = rolloutPosition; i < rolloutSequence.size(); ++i) {
+        policy.principal.push_back(rolloutSequence[i]);
+    }
+
+    std::function<void(int, int, bool)> visit = [&](int nodeIndex, int step,
+                                                    bool onPrincipal) {
+        const Node& node = _nodes[nodeIndex];
+        if (node.visits < minVisits || node.firstEdge < 0) {
+            return;
+        }
+
+        const Edge& best = _edges[bestEdge(node)];
+        if (best.visits >= minVisits) {
+            policy.entries.push_back({node.key, step, onPrincipal, best.action,
+                                      best.visits, best.valueSum / best.visits});
+        }
+
+        for (int i = node.firstEdge; i < node.firstEdge + node.edgeCount; ++i) {
+            bool follows = onPrincipal && step < policy.principal.size() &&
+                           _edges[i].action == policy.principal[step];
+            for (int c = _edges[i].firstChild; c >= 0 && c < nodeCount;
+                 c = _nodes[c].nextSibling) {
+                visit(c, step + 1, follows);
+            }
+        }
+    };
+    visit(0, 0, true);
+
+    return policy;
+}
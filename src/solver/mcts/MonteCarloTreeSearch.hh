@@ -0,0 +1,95 @@
+#ifndef SOLVER_MCTS_MONTECARLOTREESEARCH_HH_
+#define SOLVER_MCTS_MONTECARLOTREESEARCH_HH_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../../model/State.hh"
+#include "../../model/StateKey.hh"
+#include "../Individual.hh"
+#include "Policy.hh"
+
+class MonteCarloSim;
+class SolverSettings;
+class Synth;
+class ThreadPool;
+
+// Monte Carlo Tree Search over the actual, randomized craft: every playout steps
+// through MonteCarloSim, so material conditions and failed actions lead to
+// distinct children. The result is a policy that picks an action for each state
+// and condition visited often enough, rather than one fixed sequence.
+//
+// Threads share one tree. Edges being explored carry a virtual loss, which
+// steers concurrent playouts apart. Nodes and edges come from pools sized
+// once up front; when they run out, playouts keep running from the leaves.
+class MonteCarloTreeSearch {
+   public:
+    // Once stop is set, no more playouts start and search() returns the policy of
+    // the tree built so far.
+    MonteCarloTreeSearch(const SolverSettings& settings, ThreadPool& pool,
+                         const std::atomic<bool>* stop = nullptr);
+
+    // The tree is built around a reference macro: any usable action may be
+    // played, but only playing the macro's next action moves along it, so other
+    // actions are insertions. Playouts leave the tree by finishing the macro.
+    Policy search(const Synth& synth, const ActionSequence& rolloutSequence);
+
+   private:
+    struct Edge {
+        ActionId action;
+        int      visits;
+        int      virtualLoss;
+        int      firstChild;  // Outcome nodes are chained through Node::nextSibling.
+        double   valueSum;
+    };
+
+    struct Node {
+        std::mutex mutex;
+        StateKey   key;
+        int        position;  // Next action of the rollout sequence.
+        int        visits;
+        int        firstEdge;  // -1 until expanded.
+        int        edgeCount;
+        int        nextSibling;
+    };
+
+    void playout(const Synth& synth, MonteCarloSim& sim,
+                 const ActionSequence& rolloutSequence,
+                 std::vector<std::pair<int, int>>& path);
+
+    bool expand(Node& node, const State& state);
+    int  select(const Node& node) const;
+    int  child(Node& node, int edgeIndex, const StateKey& key, int position,
+               bool& created);
+    int  newNode(const StateKey& key, int position);
+
+    void rollout(MonteCarloSim& sim, State& state, int depth, int position,
+                 const ActionSequence& rolloutSequence) const;
+    void backpropagate(const std::vector<std::pair<int, int>>& path, double reward);
+
+    void applyAction(MonteCarloSim& sim, State& state, ActionId actionId) const;
+
+    bool   isTerminal(const State& state, int depth) const;
+    double reward(const State& state) const;
+
+    Policy extractPolicy(const ActionSequence& rolloutSequence) const;
+
+    const SolverSettings&    settings;
+    ThreadPool&              _pool;
+    const std::atomic<bool>* _stop;
+
+    int    _maxDepth;
+    double _exploration;
+
+    std::unique_ptr<Node[]> _nodes;
+    std::unique_ptr<Edge[]> _edges;
+    int                     _nodeCapacity;
+    int                     _edgeCapacity;
+    std::atomic<int>        _nodeCount;
+    std::atomic<int>        _edgeCount;
+};
+
+#endif  // SOLVER_MCTS_MONTECARLOTREESEARCH_HH_
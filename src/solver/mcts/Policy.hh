@@ -0,0 +1,28 @@
+#ifndef SOLVER_MCTS_POLICY_HH_
+#define SOLVER_MCTS_POLICY_HH_
+
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../../model/StateKey.hh"
+#include "../Individual.hh"
+
+// The action to take in one state of the craft, condition included.
+struct PolicyEntry {
+    StateKey key;
+    int      step;         // Actions taken before reaching this state.
+    bool     onPrincipal;  // Reached by the principal line's actions.
+    ActionId action;
+    int      visits;
+    double   value;  // Mean playout reward after taking the action.
+};
+
+struct Policy {
+    std::vector<PolicyEntry> entries;
+
+    // The most visited line through the tree, for display and as the macro to
+    // follow where the policy has no entry.
+    ActionSequence principal;
+};
+
+#endif  // SOLVER_MCTS_POLICY_HH_
@@ -0,0 +1,96 @@
+#include "PolicyTable.hh"
+
+#include <algorithm>
+
+#include "../../model/Crafter.hh"
+#include "../../model/Recipe.hh"
+#include "../../model/State.hh"
+#include "../../model/Synth.hh"
+
+constexpr int CONDITION_COUNT = 4;
+
+PolicyTable::PolicyTable()
+    : _buckets(1),
+      _steps(0),
+      _maxProgress(1),
+      _maxQuality(1),
+      _maxDurability(1),
+      _maxCp(1) {}
+
+PolicyTable::PolicyTable(const Policy& policy, const Synth& synth, int buckets)
+    : _buckets(std::max(1, buckets)),
+      _steps(policy.principal.size()),
+      _maxProgress(std::max(1, synth.recipe.difficulty)),
+      _maxQuality(std::max(1, synth.recipe.maxQuality)),
+      _maxDurability(std::max(1, synth.recipe.durability)),
+      _maxCp(std::max(1, synth.crafter.craftingPoints)),
+      _fallback(policy.principal) {
+    _cells.assign(size_t(_steps) * CONDITION_COUNT * _buckets * _buckets * _buckets *
+                      _buckets,
+                  0);
+    std::vector<int> cellVisits(_cells.size(), 0);
+
+    // Only states reached along the principal line line up with the fallback.
+    for (const PolicyEntry& entry : policy.entries) {
+        if (!entry.onPrincipal || entry.step >= _steps) {
+            continue;
+        }
+
+        const StateKey& key = entry.key;
+        int i = index(entry.step, key.condition, key.progress, key.quality,
+                      key.durability, key.cp);
+        if (entry.visits > cellVisits[i]) {
+            cellVisits[i] = entry.visits;
+            _cells[i] = uint8_t(entry.action + 1);
+        }
+    }
+
+    // Agreeing with the fallback is the same as having no decision.
+    for (int i = 0; i < _cells.size(); ++i) {
+        if (_cells[i] > 0 && _fallback[i / (_cells.size() / _steps)] == _cells[i] - 1) {
+            _cells[i] = 0;
+        }
+    }
+}
+
+ActionId PolicyTable::lookup(const State& state, int step) const {
+    if (step >= _steps) {
+        return NoAction;
+    }
+
+    int cell = _cells[index(step, state.condition(), state.progress(), state.quality(),
+                            state.durability(), state.cp())];
+    return cell > 0 ? ActionId(cell - 1) : NoAction;
+}
+
+std::vector<int> PolicyTable::decidedCells() const {
+    std::vector<int> cells;
+    for (int i = 0; i < _cells.size(); ++i) {
+        if (_cells[i] > 0) {
+            cells.push_back(i);
+        }
+    }
+    return cells;
+}
+
+ActionId PolicyTable::decision(int cell) const {
+    return _cells[cell] > 0 ? ActionId(_cells[cell] - 1) : NoAction;
+}
+
+void PolicyTable::setDecision(int cell, ActionId action) {
+    _cells[cell] = action == NoAction ? 0 : uint8_t(action + 1);
+}
+
+int PolicyTable::index(int step, Condition condition, double progress, double quality,
+                       double durability, double cp) const {
+    int i = step * CONDITION_COUNT + condition;
+    i = i * _buckets + bucket(progress, _maxProgress);
+    i = i * _buckets + bucket(quality, _maxQuality);
+    i = i * _buckets + bucket(durability, _maxDurability);
+    i = i * _buckets + bucket(cp, _maxCp);
+    return i;
+}
+
+int PolicyTable::bucket(double value, double max) const {
+    return std::clamp(int(value / max * _buckets), 0, _buckets - 1);
+}
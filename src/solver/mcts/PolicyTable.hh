@@ -0,0 +1,58 @@
+#ifndef SOLVER_MCTS_POLICYTABLE_HH_
+#define SOLVER_MCTS_POLICYTABLE_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../../model/Condition.hh"
+#include "../Individual.hh"
+#include "Policy.hh"
+
+class State;
+class Synth;
+
+// Decision table form of a Policy, compact enough to ship as solver output and
+// cheap enough to evaluate like a macro. The principal line is the fallback
+// macro; the table holds the policy's deviations from it along the way.
+//
+// Cells are indexed by step along the fallback macro, condition and a coarse
+// bucket of progress, quality, durability and CP, so a lookup is a few
+// multiplications. Where several policy states share a cell, the most visited
+// one wins. A deviation is inserted before the fallback's next action, and the
+// table is only consulted again once that action has been played.
+class PolicyTable {
+   public:
+    PolicyTable();
+    PolicyTable(const Policy& policy, const Synth& synth, int buckets);
+
+    // The action to insert in a state reached after playing the first `step`
+    // actions of the fallback macro, NoAction to play the next one.
+    ActionId lookup(const State& state, int step) const;
+
+    const ActionSequence& fallback() const { return _fallback; }
+
+    int steps() const { return _steps; }
+
+    // Cells holding a decision, and access to them for pruning.
+    std::vector<int> decidedCells() const;
+    ActionId         decision(int cell) const;
+    void             setDecision(int cell, ActionId action);
+
+   private:
+    int index(int step, Condition condition, double progress, double quality,
+              double durability, double cp) const;
+    int bucket(double value, double max) const;
+
+    int    _buckets;
+    int    _steps;
+    double _maxProgress;
+    double _maxQuality;
+    double _maxDurability;
+    double _maxCp;
+
+    std::vector<uint8_t> _cells;  // ActionId + 1, 0 when undecided.
+    ActionSequence       _fallback;
+};
+
+#endif  // SOLVER_MCTS_POLICYTABLE_HH_
@@ -10,9 +10,17 @@
 #include "../../model/Crafter.hh"
 #include "../../model/Recipe.hh"
 #include "../../model/Synth.hh"
+#include "../mcts/PolicyTable.hh"
+#include "../profile/Profiler.hh"
+#include "../profile/Trace.hh"
 
 MonteCarloSim::MonteCarloSim() : _rng(_seed()), _dist(0.0, 1.0) {}
 
+void MonteCarloSim::seed(unsigned value) {
+    _rng.seed(value);
+    _dist.reset();
+}
+
 State MonteCarloSim::step(const State& startState, const Action& action,
                           bool assumeSuccess, bool verbose, bool debug) {
     // Clone startState to keep it immutable.
@@ -142,19 +150,52 @@ State MonteCarloSim::step(const State& startState, const Action& action,
 }
 
 std::vector<State> MonteCarloSim::sequence(
-    const ActionSequence& individualOrig, const State& startState, bool assumeSuccess,
+    const ActionSequence& individual, const State& startState, bool assumeSuccess,
     ConditionalActionHandling conditionalActionHandling, bool verbose, bool debug) {
+    std::vector<State> states;
+    simulate(individual, startState, assumeSuccess, conditionalActionHandling, verbose,
+             debug, &states);
+    return states;
+}
+
+int MonteCarloSim::successes(const ActionSequence& individual, const State& startState,
+                             int                       nRuns,
+                             ConditionalActionHandling conditionalActionHandling) {
+    int nSuccesses = 0;
+    for (int i = 0; i < nRuns; ++i) {
+        State s = simulate(individual, startState, false, conditionalActionHandling,
+                           false, false, nullptr);
+
+        bool progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
+        s.checkViolations(progressOk, cpOk, durabilityOk, trickOk, reliabilityOk);
+        nSuccesses += progressOk && durabilityOk && cpOk;
+    }
+    return nSuccesses;
+}
+
+State MonteCarloSim::simulate(const ActionSequence& individualOrig,
+                              const State&              startState,
+                              bool                      assumeSuccess,
+                              ConditionalActionHandling conditionalActionHandling,
+                              bool verbose, bool debug, std::vector<State>* states) {
+    PROFILE_PHASE(PhaseMonteCarloSim);
+
     State s(startState);
 
-    // Copy individual to allow repositioning.
-    ActionSequence individual(individualOrig);
+    // Repositioning plays the conditional actions apart from the rest.
+    ActionSequence        repositioned;
+    const ActionSequence& individual =
+        conditionalActionHandling == Reposition ? repositioned : individualOrig;
 
     // Initialize counter
     int maxConditionUses = 0;
 
     // Check for empty individuals
-    if (individual.empty()) {
-        return {startState};
+    if (individualOrig.empty()) {
+        if (states != nullptr) {
+            states->push_back(startState);
+        }
+        return startState;
     }
 
     // Strip TricksOfTrade from individual
@@ -162,10 +203,9 @@ std::vector<State> MonteCarloSim::sequence(
     std::deque<ActionId> onGoodOnlyActions;
     std::deque<ActionId> onGoodOrExcellentActions;
     std::deque<ActionId> onPoorOnlyActions;
-    ActionSequence       tempIndividual;
     if (conditionalActionHandling == Reposition) {
-        for (int i = 0; i < individual.size(); ++i) {
-            const ActionId aId = individual[i];
+        for (int i = 0; i < individualOrig.size(); ++i) {
+            const ActionId aId = individualOrig[i];
             const Action&  a = ALL_ACTIONS[aId];
             if (a.onExcellent && !a.onGood) {
                 onExcellentOnlyActions.push_back(aId);
@@ -180,10 +220,9 @@ std::vector<State> MonteCarloSim::sequence(
                 onPoorOnlyActions.push_back(aId);
                 maxConditionUses++;
             } else {
-                tempIndividual.push_back(aId);
+                repositioned.push_back(aId);
             }
         }
-        individual = std::move(tempIndividual);
     }
 
     if (debug) {
@@ -203,9 +242,14 @@ std::vector<State> MonteCarloSim::sequence(
                "Normal", 0);
     }
 
-    std::vector<State> states;
+    // Every state along the way, for callers that asked for them.
+    const auto record = [states](const State& s) {
+        if (states != nullptr) {
+            states->push_back(s);
+        }
+    };
 
-    states.push_back(s);
+    record(s);
 
     for (int i = 0; i < individual.size(); ++i) {
         std::vector<const Action*> actionsArray;
@@ -222,10 +266,7 @@ std::vector<State> MonteCarloSim::sequence(
 
         for (const auto& action : actionsArray) {
             // Determine if action is usable.
-            bool usable = (action->onExcellent && s._condition == Excellent) ||
-                          (action->onGood && s._condition == Good) ||
-                          (action->onPoor && s._condition == Poor) ||
-                          (!action->onExcellent && !action->onGood && !action->onPoor);
+            bool usable = action->isUsable(s._condition);
 
             if (conditionalActionHandling == Reposition) {
                 // Manually re-add condition dependent action when conditions are met
@@ -235,12 +276,12 @@ std::vector<State> MonteCarloSim::sequence(
                             s = step(s, ALL_ACTIONS[onExcellentOnlyActions.front()],
                                      assumeSuccess, verbose, debug);
                             onExcellentOnlyActions.pop_front();
-                            states.push_back(s);
+                            record(s);
                         } else if (!onGoodOrExcellentActions.empty()) {
                             s = step(s, ALL_ACTIONS[onGoodOrExcellentActions.front()],
                                      assumeSuccess, verbose, debug);
                             onGoodOrExcellentActions.pop_front();
-                            states.push_back(s);
+                            record(s);
                         }
                     }
                     if (s._condition == Good) {
@@ -248,12 +289,12 @@ std::vector<State> MonteCarloSim::sequence(
                             s = step(s, ALL_ACTIONS[onGoodOnlyActions.front()],
                                      assumeSuccess, verbose, debug);
                             onGoodOnlyActions.pop_front();
-                            states.push_back(s);
+                            record(s);
                         } else if (!onGoodOrExcellentActions.empty()) {
                             s = step(s, ALL_ACTIONS[onGoodOrExcellentActions.front()],
                                      assumeSuccess, verbose, debug);
                             onGoodOrExcellentActions.pop_front();
-                            states.push_back(s);
+                            record(s);
                         }
                     }
                     if (s._condition == Poor) {
@@ -261,14 +302,14 @@ std::vector<State> MonteCarloSim::sequence(
                             s = step(s, ALL_ACTIONS[onPoorOnlyActions.front()],
                                      assumeSuccess, verbose, debug);
                             onPoorOnlyActions.pop_front();
-                            states.push_back(s);
+                            record(s);
                         }
                     }
                 }
 
                 // Process the original action as another step
                 s = step(s, *action, assumeSuccess, verbose, debug);
-                states.push_back(s);
+                record(s);
             } else if (conditionalActionHandling == SkipUnusable) {
                 // If not usable, record a skipped action without
                 // progressing other status counters
@@ -276,17 +317,17 @@ std::vector<State> MonteCarloSim::sequence(
                     s = State(s);
                     s._action = action->id;
                     s._wastedActions += 1;
-                    states.push_back(s);
+                    record(s);
                 }
                 // Otherwise, process action as normal
                 else {
                     s = step(s, *action, assumeSuccess, verbose, debug);
-                    states.push_back(s);
+                    record(s);
                 }
             } else if (conditionalActionHandling == IgnoreUnusable) {
                 // If not usable, skip action effect, progress other status counters
                 s = step(s, *action, assumeSuccess, verbose, debug);
-                states.push_back(s);
+                record(s);
             }
         }
     }
@@ -304,12 +345,14 @@ std::vector<State> MonteCarloSim::sequence(
             bool2str(trickOk), bool2str(reliabilityOk), s._wastedActions);
     }
 
-    return states;
+    return s;
 }
 
 MonteCarloStats MonteCarloSim::execute(
     const ActionSequence& individual, const Synth& synth, int nRuns, bool assumeSuccess,
     ConditionalActionHandling conditionalActionHandling, bool verbose, bool debug) {
+    TraceSpan span("monteCarlo", "runs", nRuns);
+
     State startState(synth);
 
     std::vector<State> bestSequenceStates;
@@ -342,6 +385,62 @@ MonteCarloStats MonteCarloSim::execute(
         }
     }
 
+    MonteCarloStats stats = summarize(finalStateTracker, synth, verbose);
+
+    if (verbose) {
+        printf("\nMonte Carlo Random Example\n==========================\n");
+    }
+
+    sequence(individual, startState, assumeSuccess, conditionalActionHandling, false,
+             debug);
+
+    if (verbose) {
+        printf("\nMonte Carlo Best Example\n==========================\n");
+
+        printf("%-2s %30s %-5s %-5s %-8s %-8s %-5s %-5s %-5s %-5s %-5s %-5s %-10s %-5s\n",
+               "#", "Action", "DUR", "CP", "QUA", "PRG", "IQ", "CTL", "QINC", "BPRG",
+               "BQUA", "WAC", "Cond", "S/F");
+
+        for (int i = 0; i < bestSequenceStates.size(); i++) {
+            const State& s = bestSequenceStates[i];
+            const char*  actionName = ALL_ACTIONS[s._action].fullName;
+            printf(
+                "%2d %30s %5.0f %5.0f %8.0f %8.0f %5.0f %5d %5.0f %5.0f %5.0f %5.0f "
+                "%-10s "
+                "%5.0f\n",
+                s._step, actionName, s._durabilityState, s._cpState, s._qualityState,
+                s._progressState, s._iqCnt, s._control, s._qualityGain, s._bProgressGain,
+                s._bQualityGain, s._wastedActions, condition2str(s._condition),
+                s._success);
+        }
+
+        printf("\nMonte Carlo Worst Example\n==========================\n");
+
+        printf("%-2s %30s %-5s %-5s %-8s %-8s %-5s %-5s %-5s %-5s %-5s %-5s %-10s %-5s\n",
+               "#", "Action", "DUR", "CP", "QUA", "PRG", "IQ", "CTL", "QINC", "BPRG",
+               "BQUA", "WAC", "Cond", "S/F");
+
+        for (int i = 0; i < worstSequenceStates.size(); i++) {
+            const State& s = worstSequenceStates[i];
+            const char*  actionName = ALL_ACTIONS[s._action].fullName;
+            printf(
+                "%2d %30s %5.0f %5.0f %8.0f %8.0f %5.0f %5d %5.0f %5.0f %5.0f %5.0f "
+                "%-10s "
+                "%5.0f\n",
+                s._step, actionName, s._durabilityState, s._cpState, s._qualityState,
+                s._progressState, s._iqCnt, s._control, s._qualityGain, s._bProgressGain,
+                s._bQualityGain, s._wastedActions, condition2str(s._condition),
+                s._success);
+        }
+
+        printf("\n");
+    }
+
+    return stats;
+}
+
+MonteCarloStats MonteCarloSim::summarize(const std::vector<State>& finalStateTracker,
+                                         const Synth& synth, bool verbose) {
     std::vector<MonteCarloStats::Stats> list(finalStateTracker.size());
     MonteCarloStats::Stats              avg{0}, mdn{0}, min{0}, max{0};
     int                                 nHQ{0};
@@ -431,55 +530,83 @@ MonteCarloStats MonteCarloSim::execute(
                max.hqPercent);
 
         printf("\n%2s %-20s %5.1f %%\n", "##", "Success Rate: ", successRate);
-        printf("\nMonte Carlo Random Example\n==========================\n");
     }
 
-    sequence(individual, startState, assumeSuccess, conditionalActionHandling, false,
-             debug);
+    return {successRate, avg, mdn, min, max};
+}
 
-    if (verbose) {
-        printf("\nMonte Carlo Best Example\n==========================\n");
+State MonteCarloSim::play(const PolicyTable& policy, const State& startState,
+                          bool assumeSuccess, bool verbose, bool debug) {
+    PROFILE_PHASE(PhaseMonteCarloSim);
 
-        printf("%-2s %30s %-5s %-5s %-8s %-8s %-5s %-5s %-5s %-5s %-5s %-5s %-10s %-5s\n",
-               "#", "Action", "DUR", "CP", "QUA", "PRG", "IQ", "CTL", "QINC", "BPRG",
-               "BQUA", "WAC", "Cond", "S/F");
+    State                 s(startState);
+    const ActionSequence& fallback = policy.fallback();
+    const Recipe&         recipe = s.synth->recipe;
 
-        for (int i = 0; i < bestSequenceStates.size(); i++) {
-            const State& s = bestSequenceStates[i];
-            const char*  actionName = ALL_ACTIONS[s._action].fullName;
-            printf(
-                "%2d %30s %5.0f %5.0f %8.0f %8.0f %5.0f %5d %5.0f %5.0f %5.0f %5.0f "
-                "%-10s "
-                "%5.0f\n",
-                s._step, actionName, s._durabilityState, s._cpState, s._qualityState,
-                s._progressState, s._iqCnt, s._control, s._qualityGain, s._bProgressGain,
-                s._bQualityGain, s._wastedActions, condition2str(s._condition),
-                s._success);
-        }
+    // Next fallback action. Every insertion is followed by a fallback action.
+    int  position = 0;
+    int  maxTurns = 2 * fallback.size();
+    bool inserted = false;
 
-        printf("\nMonte Carlo Worst Example\n==========================\n");
+    for (int turn = 0; turn < maxTurns; ++turn) {
+        if (s._progressState >= recipe.difficulty || s._durabilityState <= 0 ||
+            s._cpState < 0) {
+            break;
+        }
 
-        printf("%-2s %30s %-5s %-5s %-8s %-8s %-5s %-5s %-5s %-5s %-5s %-5s %-10s %-5s\n",
-               "#", "Action", "DUR", "CP", "QUA", "PRG", "IQ", "CTL", "QINC", "BPRG",
-               "BQUA", "WAC", "Cond", "S/F");
+        ActionId actionId = inserted ? NoAction : policy.lookup(s, position);
+        if (actionId == NoAction || !ALL_ACTIONS[actionId].isUsable(s._condition)) {
+            while (position < fallback.size() &&
+                   !ALL_ACTIONS[fallback[position]].isUsable(s._condition)) {
+                position++;
+            }
+            if (position >= fallback.size()) {
+                break;
+            }
+            actionId = fallback[position];
+        }
+        inserted = actionId != fallback[position];
+        if (!inserted) {
+            position++;
+        }
 
-        for (int i = 0; i < worstSequenceStates.size(); i++) {
-            const State& s = worstSequenceStates[i];
-            const char*  actionName = ALL_ACTIONS[s._action].fullName;
-            printf(
-                "%2d %30s %5.0f %5.0f %8.0f %8.0f %5.0f %5d %5.0f %5.0f %5.0f %5.0f "
-                "%-10s "
-                "%5.0f\n",
-                s._step, actionName, s._durabilityState, s._cpState, s._qualityState,
-                s._progressState, s._iqCnt, s._control, s._qualityGain, s._bProgressGain,
-                s._bQualityGain, s._wastedActions, condition2str(s._condition),
-                s._success);
+        const Action& action = ALL_ACTIONS[actionId];
+        if (action.isCombo) {
+            for (const auto& comboActionId : action.comboActions) {
+                s = step(s, ALL_ACTIONS[comboActionId], assumeSuccess, verbose, debug);
+            }
+        } else {
+            s = step(s, action, assumeSuccess, verbose, debug);
         }
+    }
+
+    return s;
+}
+
+MonteCarloStats MonteCarloSim::execute(const PolicyTable& policy, const Synth& synth,
+                                       int nRuns, bool assumeSuccess, bool verbose,
+                                       bool debug) {
+    TraceSpan span("monteCarlo", "runs", nRuns);
+
+    State startState(synth);
+
+    std::vector<State> finalStateTracker;
+    finalStateTracker.reserve(nRuns);
+
+    for (int i = 0; i < nRuns; ++i) {
+        finalStateTracker.push_back(
+            play(policy, startState, assumeSuccess, false, false));
+    }
 
+    MonteCarloStats stats = summarize(finalStateTracker, synth, verbose);
+
+    if (verbose || debug) {
+        printf("\nMonte Carlo Policy Example\n==========================\n");
+        play(policy, startState, assumeSuccess, verbose, debug);
         printf("\n");
     }
 
-    return {successRate, avg, mdn, min, max};
+    return stats;
 }
 
 double MonteCarloSim::qualityPercent(double quality, const Synth& synth) const {
@@ -10,11 +10,15 @@
 #include "MonteCarloStats.hh"
 
 class Action;
+class PolicyTable;
 
 class MonteCarloSim {
    public:
     MonteCarloSim();
 
+    // Restarts the random stream, for runs that must be reproducible.
+    void seed(unsigned value);
+
     State step(const State& startState, const Action& action, bool assumeSuccess,
                bool verbose, bool debug);
 
@@ -23,11 +27,24 @@ class MonteCarloSim {
                                 ConditionalActionHandling conditionalActionHandling,
                                 bool verbose, bool debug);
 
+    // Runs the sequence nRuns times and counts the runs that finish the craft,
+    // without keeping the states along the way.
+    int successes(const ActionSequence& individual, const State& startState, int nRuns,
+                  ConditionalActionHandling conditionalActionHandling);
+
     MonteCarloStats execute(const ActionSequence& individual, const Synth& synth,
                             int nRuns, bool assumeSuccess,
                             ConditionalActionHandling conditionalActionHandling,
                             bool verbose, bool debug);
 
+    // Plays the table's fallback macro, inserting the table's decisions along
+    // the way, until the craft ends.
+    State play(const PolicyTable& policy, const State& startState, bool assumeSuccess,
+               bool verbose, bool debug);
+
+    MonteCarloStats execute(const PolicyTable& policy, const Synth& synth, int nRuns,
+                            bool assumeSuccess, bool verbose, bool debug);
+
    private:
     // RNG
     duthomhas::csprng                _seed;
@@ -36,6 +53,16 @@ class MonteCarloSim {
 
     inline double random() { return _dist(_rng); }
 
+    // sequence() without the copies: returns the final state, and only records
+    // the ones along the way if states isn't null.
+    State simulate(const ActionSequence& individual, const State& startState,
+                   bool                      assumeSuccess,
+                   ConditionalActionHandling conditionalActionHandling, bool verbose,
+                   bool debug, std::vector<State>* states);
+
+    MonteCarloStats summarize(const std::vector<State>& finalStateTracker,
+                              const Synth& synth, bool verbose);
+
     double qualityPercent(double quality, const Synth& synth) const;
     double qualityFromHqPercent(double hqPercent) const;
     double hqPercentFromQuality(double qualityPercent) const;
@@ -0,0 +1,84 @@
+#include "AdaptivePursuit.hh"
+
+AdaptivePursuit::AdaptivePursuit(const std::array<double, MUTATION_COUNT>& weights,
+                                 const OperatorVars&                       vars)
+    : _vars(vars), _stats{}, _applied{}, _successes{} {
+    double total = 0;
+    for (double weight : weights) {
+        total += weight;
+    }
+    for (int i = 0; i < MUTATION_COUNT; ++i) {
+        _stats[i].probability = weights[i] / total;
+    }
+    _stats[Crossover].probability = 1;
+}
+
+GeneticOperator AdaptivePursuit::pick(double r) const {
+    for (int i = 0; i < MUTATION_COUNT - 1; ++i) {
+        r -= _stats[i].probability;
+        if (r < 0) {
+            return static_cast<GeneticOperator>(i);
+        }
+    }
+    return static_cast<GeneticOperator>(MUTATION_COUNT - 1);
+}
+
+void AdaptivePursuit::credit(unsigned operators, bool success) {
+    for (int i = 0; i < GENETIC_OPERATOR_COUNT; ++i) {
+        if (operators & (1u << i)) {
+            _applied[i] += 1;
+            _successes[i] += success;
+        }
+    }
+}
+
+void AdaptivePursuit::update() {
+    for (int i = 0; i < GENETIC_OPERATOR_COUNT; ++i) {
+        OperatorStats& op = _stats[i];
+        if (_applied[i] > 0) {
+            double rate = static_cast<double>(_successes[i]) / _applied[i];
+            op.quality += _vars.learningRate * (rate - op.quality);
+        }
+        op.applied += _applied[i];
+        op.successes += _successes[i];
+    }
+    _applied.fill(0);
+    _successes.fill(0);
+
+    if (!_vars.adaptive) {
+        return;
+    }
+
+    // Ties go to the likelier mutation, so that nothing moves before some
+    // mutation has succeeded.
+    int best = 0;
+    for (int i = 1; i < MUTATION_COUNT; ++i) {
+        const OperatorStats& op = _stats[i];
+        if (op.quality > _stats[best].quality ||
+            (op.quality == _stats[best].quality &&
+             op.probability > _stats[best].probability)) {
+            best = i;
+        }
+    }
+    if (_stats[best].quality <= 0) {
+        return;
+    }
+
+    const double minProbability = _vars.minProbability;
+    const double maxProbability = 1 - (MUTATION_COUNT - 1) * minProbability;
+    for (int i = 0; i < MUTATION_COUNT; ++i) {
+        double target = i == best ? maxProbability : minProbability;
+        _stats[i].probability += _vars.adaptationRate * (target - _stats[i].probability);
+    }
+}
+
+const std::array<OperatorStats, GENETIC_OPERATOR_COUNT>& AdaptivePursuit::stats() const {
+    return _stats;
+}
+
+void AdaptivePursuit::restore(
+    const std::array<OperatorStats, GENETIC_OPERATOR_COUNT>& stats) {
+    _stats = stats;
+    _applied.fill(0);
+    _successes.fill(0);
+}
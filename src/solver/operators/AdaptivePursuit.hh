@@ -0,0 +1,54 @@
+#ifndef SOLVER_OPERATORS_ADAPTIVEPURSUIT_HH_
+#define SOLVER_OPERATORS_ADAPTIVEPURSUIT_HH_
+
+#include <array>
+
+#include "GeneticOperator.hh"
+#include "OperatorVars.hh"
+
+struct OperatorStats {
+    // Offspring the operator took part in making, over the whole run.
+    long   applied;
+    // Of those, the ones fitter than their parent that made it into the
+    // subpopulation.
+    long   successes;
+    // Success rate, weighted towards the latest generations.
+    double quality;
+    // Odds of the operator being picked, for mutations.
+    double probability;
+};
+
+// Adaptive pursuit over the mutations of one subpopulation.
+//
+// After every generation each operator's success rate estimate moves towards
+// its rate in that generation, and the odds of all mutations move towards
+// picking the best estimated one as often as possible while leaving the others
+// at least vars.minProbability.
+class AdaptivePursuit {
+   public:
+    // weights are the odds to start with, in proportion.
+    AdaptivePursuit(const std::array<double, MUTATION_COUNT>& weights,
+                    const OperatorVars&                       vars);
+
+    // The mutation the odds give for r, uniform in [0, 1).
+    GeneticOperator pick(double r) const;
+
+    // Counts an offspring made by the operators set in a bit mask.
+    void credit(unsigned operators, bool success);
+
+    // Moves the estimates and, if adaptive, the odds by the generation's counts.
+    void update();
+
+    const std::array<OperatorStats, GENETIC_OPERATOR_COUNT>& stats() const;
+    // Carries on from the stats of another, taken between generations.
+    void restore(const std::array<OperatorStats, GENETIC_OPERATOR_COUNT>& stats);
+
+   private:
+    OperatorVars                                      _vars;
+    std::array<OperatorStats, GENETIC_OPERATOR_COUNT> _stats;
+    // Counts of the current generation.
+    std::array<long, GENETIC_OPERATOR_COUNT>          _applied;
+    std::array<long, GENETIC_OPERATOR_COUNT>          _successes;
+};
+
+#endif  // SOLVER_OPERATORS_ADAPTIVEPURSUIT_HH_
@@ -0,0 +1,27 @@
+#ifndef SOLVER_OPERATORS_GENETICOPERATOR_HH_
+#define SOLVER_OPERATORS_GENETICOPERATOR_HH_
+
+#include <array>
+#include <cstddef>
+
+// The ways the genetic engine varies individuals. The mutations come first.
+enum GeneticOperator {
+    MutateRandomSubSequence = 0,
+    MutateSwap,
+    MutateReverse,
+    MutatePoint,
+    MutateKillSubSequence,
+    Crossover,
+    GENETIC_OPERATOR_COUNT,
+};
+
+constexpr int MUTATION_COUNT = Crossover;
+
+constexpr const char *operator2str(GeneticOperator op) {
+    constexpr std::array<const char *, GENETIC_OPERATOR_COUNT> str{
+        "randomSubSequence", "swap",           "reverse",
+        "point",             "killSubSequence", "crossover"};
+    return str[static_cast<size_t>(op)];
+}
+
+#endif  // SOLVER_OPERATORS_GENETICOPERATOR_HH_
@@ -0,0 +1,17 @@
+#ifndef SOLVER_OPERATORS_OPERATORVARS_HH_
+#define SOLVER_OPERATORS_OPERATORVARS_HH_
+
+struct OperatorVars {
+    // Whether each subpopulation adapts the odds of its mutations to how well
+    // they did. Otherwise they keep fixed weights.
+    bool   adaptive;
+    // How fast an operator's estimated success rate follows the latest
+    // generation's.
+    double learningRate;
+    // How fast the odds move towards favouring the best operator.
+    double adaptationRate;
+    // Odds no mutation goes below.
+    double minProbability;
+};
+
+#endif  // SOLVER_OPERATORS_OPERATORVARS_HH_
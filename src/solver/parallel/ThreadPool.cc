@@ -0,0 +1,123 @@
+#include "ThreadPool.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(int threads) : _stopping(false) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // The thread calling parallelFor() always helps, so one less worker is enough.
+    for (int i = 0; i < threads - 1; ++i) {
+        _workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const { return _workers.size() + 1; }
+
+int ThreadPool::concurrency(int maxThreads) const {
+    return maxThreads > 0 ? std::min(maxThreads, size()) : size();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int)>& fn) {
+    parallelFor(n, 0, fn);
+}
+
+void ThreadPool::parallelFor(int n, int maxThreads, const std::function<void(int)>& fn) {
+    if (n <= 0) {
+        return;
+    }
+
+    // Shared with the helper tasks, which may only get to run after this call
+    // has returned if the pool is busy with other work.
+    struct Loop {
+        std::function<void(int)> fn;
+        int                      n;
+        std::atomic<int>         next;
+        std::atomic<int>         done;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        // The first exception thrown by fn, under mutex.
+        std::exception_ptr       error;
+    };
+    auto loop = std::make_shared<Loop>();
+    loop->fn = fn;
+    loop->n = n;
+    loop->next = 0;
+    loop->done = 0;
+
+    const auto work = [](Loop& loop) {
+        int i;
+        while ((i = loop.next.fetch_add(1)) < loop.n) {
+            // On an exception, the indices nobody has taken yet are dropped and
+            // counted as done here.
+            int finished = 1;
+            try {
+                loop.fn(i);
+            } catch (...) {
+                {
+                    std::lock_guard lock(loop.mutex);
+                    if (!loop.error) {
+                        loop.error = std::current_exception();
+                    }
+                }
+                int untaken = loop.next.exchange(loop.n);
+                finished += std::max(loop.n - untaken, 0);
+            }
+            if (loop.done.fetch_add(finished) + finished == loop.n) {
+                std::lock_guard lock(loop.mutex);
+                loop.cv.notify_all();
+            }
+        }
+    };
+
+    int helpers = std::min(n, concurrency(maxThreads)) - 1;
+    for (int i = 0; i < helpers; ++i) {
+        submit([loop, work]() { work(*loop); });
+    }
+
+    work(*loop);
+
+    std::unique_lock lock(loop->mutex);
+    loop->cv.wait(lock, [&]() { return loop->done == loop->n; });
+    if (loop->error) {
+        std::rethrow_exception(loop->error);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(_mutex);
+            _cv.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            if (_stopping && _tasks.empty()) {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
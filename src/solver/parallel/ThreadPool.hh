@@ -0,0 +1,48 @@
+#ifndef SOLVER_PARALLEL_THREADPOOL_HH_
+#define SOLVER_PARALLEL_THREADPOOL_HH_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+   public:
+    // A thread count of 0 uses one thread per hardware thread.
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const;
+
+    // Threads a parallelFor() limited to maxThreads gets to use. A limit of 0
+    // means the whole pool.
+    int concurrency(int maxThreads) const;
+
+    void submit(std::function<void()> task);
+
+    // Calls fn(i) for every i in [0, n) and blocks until all calls returned.
+    // The calling thread takes part in the work, so this is safe to nest
+    // inside tasks that are themselves running on the pool. If fn throws, the
+    // calls not yet started are skipped and, once the others have returned,
+    // the first exception is rethrown here.
+    void parallelFor(int n, const std::function<void(int)>& fn);
+
+    // As above, with at most concurrency(maxThreads) threads working on the loop.
+    void parallelFor(int n, int maxThreads, const std::function<void(int)>& fn);
+
+   private:
+    void workerLoop();
+
+    std::vector<std::thread>          _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex                        _mutex;
+    std::condition_variable           _cv;
+    bool                              _stopping;
+};
+
+#endif  // SOLVER_PARALLEL_THREADPOOL_HH_
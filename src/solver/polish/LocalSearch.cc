@@ -0,0 +1,171 @@
+#include "LocalSearch.hh"
+
+#include <algorithm>
+
+#include "../../model/Synth.hh"
+#include "../Solver.hh"
+#include "../SolverSettings.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+#include "../simulation/SimSynth.hh"
+
+LocalSearch::LocalSearch(const SolverSettings& settings, ThreadPool& pool)
+    : settings(settings), _pool(pool) {}
+
+Individual LocalSearch::polish(const Individual& start, const Synth& synth,
+                               int maxEdits) {
+    Individual best(start.sequence);
+    best.fitness = evaluate(best.sequence, 0, {State(synth)}, synth);
+
+    while (maxEdits >= 1) {
+        Individual next = bestNeighbour(best, synth, 1);
+        if (!(next.fitness > best.fitness) && maxEdits >= 2) {
+            next = bestNeighbour(best, synth, 2);
+        }
+        if (!(next.fitness > best.fitness)) {
+            break;
+        }
+        best = std::move(next);
+    }
+
+    return best;
+}
+
+std::vector<LocalSearch::Edit> LocalSearch::neighbourhood(
+    const ActionSequence& sequence) const {
+    const std::vector<ActionId>& actions = settings.crafter.actions;
+    int                          n = sequence.size();
+
+    std::vector<Edit> edits;
+
+    if (settings.maxLength <= 0 || n < settings.maxLength) {
+        for (int p = 0; p <= n; ++p) {
+            for (const ActionId actionId : actions) {
+                edits.push_back({Edit::Insert, p, actionId});
+            }
+        }
+    }
+
+    for (int p = 0; p < n; ++p) {
+        if (n > 1) {
+            edits.push_back({Edit::Remove, p, NoAction});
+        }
+        for (const ActionId actionId : actions) {
+            if (actionId != sequence[p]) {
+                edits.push_back({Edit::Replace, p, actionId});
+            }
+        }
+        if (p + 1 < n && sequence[p] != sequence[p + 1]) {
+            edits.push_back({Edit::Swap, p, NoAction});
+        }
+    }
+
+    return edits;
+}
+
+Individual LocalSearch::bestNeighbour(const Individual& current, const Synth& synth,
+                                      int edits) const {
+    const ActionSequence& base = current.sequence;
+
+    // Neighbours share the current sequence up to their first edit.
+    std::vector<State> prefix;
+    simulatePrefix(base, synth, prefix);
+
+    std::vector<Edit> firstEdits = neighbourhood(base);
+    if (firstEdits.empty()) {
+        return current;
+    }
+
+    // Split the neighbourhood in more chunks than threads to even out the load.
+    int threads = _pool.concurrency(settings.threads);
+    int nChunks = std::min<int>(firstEdits.size(), 4 * threads);
+
+    std::vector<Individual> chunkBest(nChunks, current);
+
+    _pool.parallelFor(nChunks, threads, [&](int chunk) {
+        TraceSpan span("polish batch", "chunk", chunk);
+
+        int begin = chunk * firstEdits.size() / nChunks;
+        int end = (chunk + 1) * firstEdits.size() / nChunks;
+
+        Individual&        best = chunkBest[chunk];
+        ActionSequence     candidate;
+        std::vector<State> firstPrefix;
+
+        const auto consider = [&](const ActionSequence&     sequence, int from,
+                                  const std::vector<State>& states) {
+            Fitness fitness = evaluate(sequence, from, states, synth);
+            if (fitness > best.fitness) {
+                best.sequence = sequence;
+                best.fitness = fitness;
+            }
+        };
+
+        for (int i = begin; i < end; ++i) {
+            ActionSequence first(base);
+            apply(first, firstEdits[i]);
+
+            if (edits == 1) {
+                consider(first, firstEdits[i].position, prefix);
+                continue;
+            }
+
+            // Edits commute but for shifted positions, so pairs are only taken
+            // in position order.
+            simulatePrefix(first, synth, firstPrefix);
+            for (const Edit& second : neighbourhood(first)) {
+                if (second.position < firstEdits[i].position) {
+                    continue;
+                }
+                candidate = first;
+                apply(candidate, second);
+                consider(candidate, second.position, firstPrefix);
+            }
+        }
+    });
+
+    return *std::max_element(
+        chunkBest.begin(), chunkBest.end(),
+        [](const Individual& x, const Individual& y) { return x.fitness < y.fitness; });
+}
+
+void LocalSearch::simulatePrefix(const ActionSequence& sequence, const Synth& synth,
+                                 std::vector<State>& prefix) const {
+    SimSynth simSynth;
+
+    prefix.clear();
+    prefix.emplace_back(synth);
+    for (const ActionId actionId : sequence) {
+        State s(prefix.back());
+        simSynth.step(s, actionId, false);
+        prefix.push_back(std::move(s));
+    }
+}
+
+Fitness LocalSearch::evaluate(const ActionSequence& sequence, int from,
+                              const std::vector<State>& prefix,
+                              const Synth&              synth) const {
+    SimSynth simSynth;
+    State    s(prefix[from]);
+    for (int i = from; i < sequence.size(); ++i) {
+        simSynth.step(s, sequence[i], false);
+    }
+    return Solver::evalState(s, synth, settings.solver.penaltyWeight, sequence.size());
+}
+
+void LocalSearch::apply(ActionSequence& sequence, const Edit& edit) {
+    switch (edit.type) {
+        case Edit::Insert:
+            sequence.insert(sequence.begin() + edit.position, edit.action);
+            break;
+        case Edit::Remove:
+            sequence.erase(sequence.begin() + edit.position);
+            break;
+        case Edit::Replace:
+            sequence[edit.position] = edit.action;
+            break;
+        case Edit::Swap:
+            std::swap(sequence[edit.position], sequence[edit.position + 1]);
+            break;
+    }
+}
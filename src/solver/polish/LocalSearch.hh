@@ -0,0 +1,53 @@
+#ifndef SOLVER_POLISH_LOCALSEARCH_HH_
+#define SOLVER_POLISH_LOCALSEARCH_HH_
+
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../../model/State.hh"
+#include "../Individual.hh"
+
+class SolverSettings;
+class Synth;
+class ThreadPool;
+
+// Hill climbing over small edits of a sequence: inserting, removing or replacing
+// one action, or swapping two adjacent ones. Every round evaluates the whole
+// neighbourhood in parallel and moves to its best member. Pairs of edits are
+// only tried once no single edit improves anymore.
+class LocalSearch {
+   public:
+    LocalSearch(const SolverSettings& settings, ThreadPool& pool);
+
+    // Returns the start itself, re-evaluated, if nothing improves on it.
+    Individual polish(const Individual& start, const Synth& synth, int maxEdits);
+
+   private:
+    struct Edit {
+        enum Type { Insert, Remove, Replace, Swap };
+
+        Type     type;
+        int      position;
+        ActionId action;
+    };
+
+    std::vector<Edit> neighbourhood(const ActionSequence& sequence) const;
+
+    Individual bestNeighbour(const Individual& current, const Synth& synth,
+                             int edits) const;
+
+    // States after every prefix of the sequence, the empty one included.
+    void simulatePrefix(const ActionSequence& sequence, const Synth& synth,
+                        std::vector<State>& prefix) const;
+
+    // Simulates only the part of the sequence after the first edited position.
+    Fitness evaluate(const ActionSequence& sequence, int from,
+                     const std::vector<State>& prefix, const Synth& synth) const;
+
+    static void apply(ActionSequence& sequence, const Edit& edit);
+
+    const SolverSettings& settings;
+    ThreadPool&           _pool;
+};
+
+#endif  // SOLVER_POLISH_LOCALSEARCH_HH_
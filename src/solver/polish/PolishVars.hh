@@ -0,0 +1,13 @@
+#ifndef SOLVER_POLISH_POLISHVARS_HH_
+#define SOLVER_POLISH_POLISHVARS_HH_
+
+struct PolishVars {
+    // Edits combined into one neighbour when polishing the final best: 1 or 2.
+    // 0 skips polishing.
+    int maxEdits;
+    // Generations between single-edit polishing of each subpopulation's best.
+    // 0 never polishes during the run.
+    int eliteInterval;
+};
+
+#endif  // SOLVER_POLISH_POLISHVARS_HH_
@@ -0,0 +1,55 @@
+#include "Allocations.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "Profiler.hh"
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocationBytes{0};
+
+}  // namespace
+
+AllocationCounts Allocations::total() {
+    return {allocationCount.load(std::memory_order_relaxed),
+            allocationBytes.load(std::memory_order_relaxed)};
+}
+
+#ifdef FFXIVCRAFTING_TRACK_ALLOCATIONS
+
+// The array and nothrow forms call these.
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    Profiler::recordAllocation(size);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    Profiler::recordAllocation(size);
+    // aligned_alloc() wants a non-zero multiple of the alignment.
+    size_t align = static_cast<size_t>(alignment);
+    size = size > 0 ? (size + align - 1) / align * align : align;
+    if (void* p = std::aligned_alloc(align, size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SOLVER_PROFILE_ALLOCATIONS_HH_
+#define SOLVER_PROFILE_ALLOCATIONS_HH_
+
+#include <cstdint>
+
+// Whether operator new is counted. Set with the TRACK_ALLOCATIONS build option,
+// which replaces the global operator new and delete of the whole program.
+#ifdef FFXIVCRAFTING_TRACK_ALLOCATIONS
+constexpr bool TRACKING_ALLOCATIONS = true;
+#else
+constexpr bool TRACKING_ALLOCATIONS = false;
+#endif
+
+struct AllocationCounts {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+class Allocations {
+   public:
+    // Made by the whole process so far, zero unless tracking allocations.
+    static AllocationCounts total();
+};
+
+#endif  // SOLVER_PROFILE_ALLOCATIONS_HH_
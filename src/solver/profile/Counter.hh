@@ -0,0 +1,26 @@
+#ifndef SOLVER_PROFILE_COUNTER_HH_
+#define SOLVER_PROFILE_COUNTER_HH_
+
+#include <array>
+#include <cstddef>
+
+// Hardware events PerfCounters counts, in user space only.
+enum Counter {
+    CounterCycles = 0,
+    CounterInstructions,
+    // Last level cache.
+    CounterCacheReferences,
+    CounterCacheMisses,
+    CounterBranches,
+    CounterBranchMisses,
+    COUNTER_COUNT,
+};
+
+constexpr const char *counter2str(Counter counter) {
+    constexpr std::array<const char *, COUNTER_COUNT> str{
+        "cycles",       "instructions", "cacheReferences",
+        "cacheMisses",  "branches",     "branchMisses"};
+    return str[static_cast<size_t>(counter)];
+}
+
+#endif  // SOLVER_PROFILE_COUNTER_HH_
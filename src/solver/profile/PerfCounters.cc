@@ -0,0 +1,149 @@
+#include "PerfCounters.hh"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The counters of one thread.
+struct ThreadGroup {
+    ThreadGroup();
+    ~ThreadGroup();
+
+    int                            leader = -1;
+    std::array<int, COUNTER_COUNT> fds;
+    // Where each counter comes in a read of the group, -1 if it isn't open.
+    std::array<int, COUNTER_COUNT> slots;
+    int                            opened = 0;
+    std::string                    error;
+};
+
+#ifdef __linux__
+
+// In the order of Counter.
+constexpr std::array<uint64_t, COUNTER_COUNT> EVENTS{
+    PERF_COUNT_HW_CPU_CYCLES,          PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES};
+
+int openCounter(Counter counter, int leader) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = EVENTS[counter];
+    // The group starts once all of it is open.
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+#endif
+
+ThreadGroup::ThreadGroup() {
+    fds.fill(-1);
+    slots.fill(-1);
+#ifdef __linux__
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        const Counter counter = static_cast<Counter>(i);
+        int           fd = openCounter(counter, leader);
+        if (fd < 0) {
+            if (error.empty()) {
+                error = std::string(counter2str(counter)) + ": " + strerror(errno);
+            }
+            continue;
+        }
+        if (leader < 0) {
+            leader = fd;
+        }
+        fds[i] = fd;
+        slots[i] = opened++;
+    }
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    error = "perf events are only available on Linux";
+#endif
+}
+
+ThreadGroup::~ThreadGroup() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+ThreadGroup& threadGroup() {
+    thread_local ThreadGroup group;
+    return group;
+}
+
+double ratio(uint64_t a, uint64_t b, double scale) {
+    return b > 0 ? scale * a / b : -1;
+}
+
+}  // namespace
+
+bool PerfCounters::read(CounterValues& values) {
+    values.fill(0);
+#ifdef __linux__
+    const ThreadGroup& group = threadGroup();
+    if (group.leader < 0) {
+        return false;
+    }
+
+    // The number of counters, the time enabled and running, then the counts.
+    uint64_t data[3 + COUNTER_COUNT];
+    if (::read(group.leader, data, sizeof(data)) < 0) {
+        return false;
+    }
+    const uint64_t enabled = data[1];
+    const uint64_t running = data[2];
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        if (group.slots[i] < 0) {
+            continue;
+        }
+        uint64_t count = data[3 + group.slots[i]];
+        values[i] = running > 0 && running < enabled
+                        ? static_cast<uint64_t>(static_cast<double>(count) * enabled /
+                                                running)
+                        : count;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PerfCounters::has(Counter counter) { return threadGroup().slots[counter] >= 0; }
+
+std::string PerfCounters::unavailableReason() {
+    const ThreadGroup& group = threadGroup();
+    return group.opened > 0 ? "" : group.error;
+}
+
+double PerfCounters::ipc(const CounterValues& values) {
+    return ratio(values[CounterInstructions], values[CounterCycles], 1);
+}
+
+double PerfCounters::cacheMissPercent(const CounterValues& values) {
+    return ratio(values[CounterCacheMisses], values[CounterCacheReferences], 100);
+}
+
+double PerfCounters::branchMissPercent(const CounterValues& values) {
+    return ratio(values[CounterBranchMisses], values[CounterBranches], 100);
+}
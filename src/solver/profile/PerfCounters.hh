@@ -0,0 +1,37 @@
+#ifndef SOLVER_PROFILE_PERFCOUNTERS_HH_
+#define SOLVER_PROFILE_PERFCOUNTERS_HH_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "Counter.hh"
+
+using CounterValues = std::array<uint64_t, COUNTER_COUNT>;
+
+// Hardware performance counters of the calling thread, through perf_event_open.
+//
+// Each thread opens its counters on first use, as one group so that they are
+// counted over the same instructions. Where perf events are missing, not
+// permitted or short of hardware counters, reads fail and the events that
+// could not be opened read as zero; nothing else changes.
+class PerfCounters {
+   public:
+    // Counts of the calling thread so far, scaled up if the kernel had to share
+    // the counters with other groups. false if none could be opened.
+    static bool read(CounterValues& values);
+
+    // Whether the calling thread can count event.
+    static bool has(Counter counter);
+
+    // Why the calling thread counts nothing, empty if it counts something.
+    static std::string unavailableReason();
+
+    // Instructions per cycle, and misses per hundred of what they missed. -1
+    // where the counts needed are zero.
+    static double ipc(const CounterValues& values);
+    static double cacheMissPercent(const CounterValues& values);
+    static double branchMissPercent(const CounterValues& values);
+};
+
+#endif  // SOLVER_PROFILE_PERFCOUNTERS_HH_
@@ -0,0 +1,32 @@
+#ifndef SOLVER_PROFILE_PHASE_HH_
+#define SOLVER_PROFILE_PHASE_HH_
+
+#include <array>
+#include <cstddef>
+
+// What the profiler times. Generation spans the phases after it up to Survivors;
+// the simulators run inside the phases that call them.
+enum Phase {
+    PhaseGeneration = 0,
+    PhaseSelection,
+    PhaseCrossover,
+    PhaseMutation,
+    PhaseEvaluation,
+    PhaseSurvivors,
+    PhasePolish,
+    PhaseProgress,
+    PhaseCheckpoint,
+    PhaseSimSynth,
+    PhaseMonteCarloSim,
+    PHASE_COUNT,
+};
+
+constexpr const char *phase2str(Phase phase) {
+    constexpr std::array<const char *, PHASE_COUNT> str{
+        "generation", "selection",  "crossover",  "mutation",     "evaluation",
+        "survivors",  "polish",     "progress",   "checkpoint",   "SimSynth",
+        "MonteCarloSim"};
+    return str[static_cast<size_t>(phase)];
+}
+
+#endif  // SOLVER_PROFILE_PHASE_HH_
@@ -0,0 +1,249 @@
+#include "Profiler.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Written by its thread only; read by processTotals() from any thread.
+struct ThreadCounters {
+    ThreadCounters();
+    ~ThreadCounters();
+
+    PhaseTotals load() const {
+        PhaseTotals totals;
+        for (int i = 0; i < PHASE_COUNT; ++i) {
+            totals.ticks[i] = ticks[i].load(std::memory_order_relaxed);
+            totals.calls[i] = calls[i].load(std::memory_order_relaxed);
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                totals.counters[i][c] = counters[i][c].load(std::memory_order_relaxed);
+            }
+            totals.allocations[i] = allocations[i].load(std::memory_order_relaxed);
+            totals.allocatedBytes[i] = allocatedBytes[i].load(std::memory_order_relaxed);
+        }
+        return totals;
+    }
+
+    std::array<std::atomic<uint64_t>, PHASE_COUNT> ticks{};
+    std::array<std::atomic<uint64_t>, PHASE_COUNT> calls{};
+    std::array<std::array<std::atomic<uint64_t>, COUNTER_COUNT>, PHASE_COUNT> counters{};
+    std::array<std::atomic<uint64_t>, PHASE_COUNT> allocations{};
+    std::array<std::atomic<uint64_t>, PHASE_COUNT> allocatedBytes{};
+};
+
+// The calling thread's innermost phase and its counters. Plain thread locals,
+// which operator new can use without constructing anything.
+thread_local Phase           currentPhase = PHASE_COUNT;
+thread_local ThreadCounters* currentCounters = nullptr;
+
+// Only the owning thread writes, so no read-modify-write is needed.
+void add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+void add(PhaseTotals& totals, const PhaseTotals& other) {
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        totals.ticks[i] += other.ticks[i];
+        totals.calls[i] += other.calls[i];
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            totals.counters[i][c] += other.counters[i][c];
+        }
+        totals.allocations[i] += other.allocations[i];
+        totals.allocatedBytes[i] += other.allocatedBytes[i];
+    }
+}
+
+// The counters of running threads, and what the threads that exited recorded.
+struct Registry {
+    std::mutex                   mutex;
+    std::vector<ThreadCounters*> threads;
+    PhaseTotals                  retired;
+};
+
+Registry& registry() {
+    // Never destroyed, threads may exit after main() returns.
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+ThreadCounters::ThreadCounters() {
+    Registry&                   r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters() {
+    Registry&                   r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    add(r.retired, load());
+    currentCounters = nullptr;
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+ThreadCounters& threadCounters() {
+    thread_local ThreadCounters counters;
+    return counters;
+}
+
+// A rate, or a dash where it is unknown, width columns wide.
+std::string formatRate(double rate, const char* format, int width) {
+    char text[32];
+    if (rate < 0) {
+        snprintf(text, sizeof(text), "%*s", width, "-");
+    } else {
+        snprintf(text, sizeof(text), format, rate);
+    }
+    return text;
+}
+
+}  // namespace
+
+PhaseTotals PhaseTotals::operator-(const PhaseTotals& other) const {
+    PhaseTotals difference;
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        difference.ticks[i] = ticks[i] - other.ticks[i];
+        difference.calls[i] = calls[i] - other.calls[i];
+        for (int c = 0; c < COUNTER_COUNT; ++c) {
+            difference.counters[i][c] = counters[i][c] - other.counters[i][c];
+        }
+        difference.allocations[i] = allocations[i] - other.allocations[i];
+        difference.allocatedBytes[i] = allocatedBytes[i] - other.allocatedBytes[i];
+    }
+    return difference;
+}
+
+void Profiler::record(Phase phase, uint64_t ticks) {
+    ThreadCounters& c = threadCounters();
+    add(c.ticks[phase], ticks);
+    add(c.calls[phase], 1);
+}
+
+void Profiler::recordCounters(Phase phase, const CounterValues& counts) {
+    ThreadCounters& c = threadCounters();
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        add(c.counters[phase][i], counts[i]);
+    }
+}
+
+Phase Profiler::enter(Phase phase) {
+    currentCounters = &threadCounters();
+    Phase previous = currentPhase;
+    currentPhase = phase;
+    return previous;
+}
+
+void Profiler::leave(Phase previous) { currentPhase = previous; }
+
+void Profiler::recordAllocation(size_t bytes) {
+    if (currentPhase != PHASE_COUNT && currentCounters != nullptr) {
+        add(currentCounters->allocations[currentPhase], 1);
+        add(currentCounters->allocatedBytes[currentPhase], bytes);
+    }
+}
+
+PhaseTotals Profiler::threadTotals() { return threadCounters().load(); }
+
+PhaseTotals Profiler::processTotals() {
+    Registry&                   r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    PhaseTotals                 totals = r.retired;
+    for (const ThreadCounters* counters : r.threads) {
+        add(totals, counters->load());
+    }
+    return totals;
+}
+
+double Profiler::ticksPerSecond() {
+    static const double rate = [] {
+#if defined(__x86_64__) || defined(__i386__)
+        // Counted against the steady clock over a short sleep.
+        const auto     start = std::chrono::steady_clock::now();
+        const uint64_t startTicks = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const uint64_t ticks = now() - startTicks;
+        return ticks / std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                     start)
+                           .count();
+#else
+        return 1e9;
+#endif
+    }();
+    return rate;
+}
+
+std::string Profiler::format(const PhaseTotals& totals) {
+    std::string text;
+    char        line[160];
+    snprintf(line, sizeof(line), "%-14s %10s %12s %12s", "Phase", "Calls", "Total ms",
+             "us/call");
+    text += line;
+    if (PROFILING_COUNTERS) {
+        snprintf(line, sizeof(line), " %6s %8s %8s", "IPC", "LLC miss", "br miss");
+        text += line;
+    }
+    if (TRACKING_ALLOCATIONS) {
+        snprintf(line, sizeof(line), " %10s %12s %11s", "Allocs", "Alloc KB",
+                 "Allocs/call");
+        text += line;
+    }
+    text += "\n";
+
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        if (totals.calls[i] == 0) {
+            continue;
+        }
+        double seconds = totals.ticks[i] / ticksPerSecond();
+        snprintf(line, sizeof(line), "%-14s %10llu %12.2f %12.3f",
+                 phase2str(static_cast<Phase>(i)),
+                 static_cast<unsigned long long>(totals.calls[i]), seconds * 1e3,
+                 seconds * 1e6 / totals.calls[i]);
+        text += line;
+        if (PROFILING_COUNTERS) {
+            const CounterValues& counts = totals.counters[i];
+            text += formatRate(PerfCounters::ipc(counts), " %6.2f", 7);
+            text += formatRate(PerfCounters::cacheMissPercent(counts), " %7.2f%%", 9);
+            text += formatRate(PerfCounters::branchMissPercent(counts), " %7.2f%%", 9);
+        }
+        if (TRACKING_ALLOCATIONS) {
+            snprintf(line, sizeof(line), " %10llu %12.1f %11.2f",
+                     static_cast<unsigned long long>(totals.allocations[i]),
+                     totals.allocatedBytes[i] / 1024.0,
+                     static_cast<double>(totals.allocations[i]) / totals.calls[i]);
+            text += line;
+        }
+        text += "\n";
+    }
+
+    if (PROFILING_COUNTERS) {
+        std::string reason = PerfCounters::unavailableReason();
+        if (!reason.empty()) {
+            text += "Hardware counters unavailable (" + reason + ").\n";
+        }
+    }
+    return text;
+}
+
+std::string Profiler::formatLine(const PhaseTotals& totals) {
+    std::string text;
+    char        field[64];
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        if (totals.calls[i] == 0) {
+            continue;
+        }
+        snprintf(field, sizeof(field), "%s%s %.2f ms", text.empty() ? "" : ", ",
+                 phase2str(static_cast<Phase>(i)),
+                 totals.ticks[i] / ticksPerSecond() * 1e3);
+        text += field;
+        if (TRACKING_ALLOCATIONS) {
+            snprintf(field, sizeof(field), " %llu allocs",
+                     static_cast<unsigned long long>(totals.allocations[i]));
+            text += field;
+        }
+    }
+    return text;
+}
@@ -0,0 +1,146 @@
+#ifndef SOLVER_PROFILE_PROFILER_HH_
+#define SOLVER_PROFILE_PROFILER_HH_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Allocations.hh"
+#include "PerfCounters.hh"
+#include "Phase.hh"
+
+// Whether PROFILE_PHASE() records anything. Set with the PROFILE_PHASES build option.
+#ifdef FFXIVCRAFTING_PROFILE
+constexpr bool PROFILING = true;
+#else
+constexpr bool PROFILING = false;
+#endif
+
+// Whether phases also read the hardware counters. Set with PROFILE_COUNTERS.
+#ifdef FFXIVCRAFTING_PERF_COUNTERS
+constexpr bool PROFILING_COUNTERS = true;
+#else
+constexpr bool PROFILING_COUNTERS = false;
+#endif
+
+// Time spent in, and times entered, each phase.
+struct PhaseTotals {
+    std::array<uint64_t, PHASE_COUNT> ticks{};
+    std::array<uint64_t, PHASE_COUNT> calls{};
+    // Zero unless profiling counters.
+    std::array<CounterValues, PHASE_COUNT> counters{};
+    // Made while the phase was the innermost one. Zero unless tracking
+    // allocations.
+    std::array<uint64_t, PHASE_COUNT> allocations{};
+    std::array<uint64_t, PHASE_COUNT> allocatedBytes{};
+
+    PhaseTotals operator-(const PhaseTotals& other) const;
+};
+
+// Counts time per phase and thread.
+//
+// Every thread keeps its own counters, which only it writes to, so recording a
+// phase takes two reads of the time stamp counter and no synchronization.
+// Nested phases are timed inclusively: a SimSynth phase inside an evaluation
+// phase counts towards both. Reading the hardware counters costs a system call
+// at either end of a phase, which shows in the times of the phases around it.
+class Profiler {
+   public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+    static void record(Phase phase, uint64_t ticks);
+    static void recordCounters(Phase phase, const CounterValues& counts);
+
+    // Makes phase the calling thread's innermost one, which allocations are
+    // counted towards. Returns the one it was, to be put back by leave().
+    static Phase enter(Phase phase);
+    static void  leave(Phase previous);
+    // Called by operator new, which must not allocate in turn.
+    static void  recordAllocation(size_t bytes);
+
+    // What the calling thread has recorded so far.
+    static PhaseTotals threadTotals();
+    // What every thread, running or not, has recorded so far.
+    static PhaseTotals processTotals();
+
+    // Measured once, on first use.
+    static double ticksPerSecond();
+
+    // A table of the phases entered, one per line, with IPC and miss rates if
+    // profiling counters and allocations if tracking them.
+    static std::string format(const PhaseTotals& totals);
+    // The same on one line, in milliseconds.
+    static std::string formatLine(const PhaseTotals& totals);
+};
+
+class ScopedPhase {
+   public:
+    explicit ScopedPhase(Phase phase) : _phase(phase) {
+#ifdef FFXIVCRAFTING_TRACK_ALLOCATIONS
+        _previous = Profiler::enter(phase);
+#endif
+#ifdef FFXIVCRAFTING_PERF_COUNTERS
+        _counted = PerfCounters::read(_startCounts);
+#endif
+        _start = Profiler::now();
+    }
+
+    ~ScopedPhase() {
+        uint64_t ticks = Profiler::now() - _start;
+#ifdef FFXIVCRAFTING_PERF_COUNTERS
+        CounterValues counts;
+        if (_counted && PerfCounters::read(counts)) {
+            for (int i = 0; i < COUNTER_COUNT; ++i) {
+                counts[i] -= _startCounts[i];
+            }
+            Profiler::recordCounters(_phase, counts);
+        }
+#endif
+        Profiler::record(_phase, ticks);
+#ifdef FFXIVCRAFTING_TRACK_ALLOCATIONS
+        Profiler::leave(_previous);
+#endif
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+   private:
+    Phase    _phase;
+    uint64_t _start;
+#ifdef FFXIVCRAFTING_PERF_COUNTERS
+    bool          _counted;
+    CounterValues _startCounts;
+#endif
+#ifdef FFXIVCRAFTING_TRACK_ALLOCATIONS
+    Phase _previous;
+#endif
+};
+
+// Times the rest of the enclosing scope as phase. Compiles to nothing unless
+// profiling.
+#ifdef FFXIVCRAFTING_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_PHASE(phase) ScopedPhase PROFILE_CONCAT(scopedPhase, __LINE__)(phase)
+#else
+#define PROFILE_PHASE(phase) \
+    do {                     \
+    } while (false)
+#endif
+
+#endif  // SOLVER_PROFILE_PROFILER_HH_
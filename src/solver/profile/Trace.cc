@@ -0,0 +1,125 @@
+#include "Trace.hh"
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct ThreadBuffer {
+    int                     thread;
+    std::vector<TraceEvent> events;
+};
+
+// Buffers outlive their threads, so that spans of threads that exited before
+// the trace is written are kept.
+struct Registry {
+    std::mutex                                 mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int64_t                                    start = 0;
+};
+
+Registry& registry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local ThreadBuffer* buffer = [] {
+        Registry&                   r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto& added = r.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        added->thread = r.buffers.size();
+        added->events.reserve(1024);
+        return added.get();
+    }();
+    return *buffer;
+}
+
+std::string quote(const char* text) {
+    std::string quoted = "\"";
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            quoted += '\\';
+        }
+        quoted += *c;
+    }
+    return quoted + "\"";
+}
+
+}  // namespace
+
+void Tracer::start() {
+    registry().start = now();
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::record(const TraceEvent& event) { threadBuffer().events.push_back(event); }
+
+void Tracer::write(const std::string& path) {
+    _enabled.store(false, std::memory_order_relaxed);
+
+    Registry&                   r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Could not open trace file " + path);
+    }
+
+    // Complete events, timed in microseconds from start().
+    char line[256];
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (const auto& buffer : r.buffers) {
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                 "\"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+                 first ? "" : ",", buffer->thread, buffer->thread);
+        file << line;
+        first = false;
+
+        for (const TraceEvent& event : buffer->events) {
+            snprintf(line, sizeof(line),
+                     ",\n{\"name\": %s, \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                     "\"ts\": %.3f, \"dur\": %.3f",
+                     quote(event.name).c_str(), buffer->thread,
+                     (event.begin - r.start) / 1e3, (event.end - event.begin) / 1e3);
+            file << line;
+            if (event.argName != nullptr) {
+                snprintf(line, sizeof(line), ", \"args\": {%s: %" PRId64 "}",
+                         quote(event.argName).c_str(), event.arg);
+                file << line;
+            }
+            file << "}";
+        }
+        buffer->events.clear();
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        throw std::runtime_error("Could not write trace file " + path);
+    }
+}
+
+TraceSession::TraceSession(std::string path) : _path(std::move(path)) {
+    if (!_path.empty()) {
+        Tracer::start();
+    }
+}
+
+TraceSession::~TraceSession() {
+    if (_path.empty()) {
+        return;
+    }
+    try {
+        Tracer::write(_path);
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SOLVER_PROFILE_TRACE_HH_
+#define SOLVER_PROFILE_TRACE_HH_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+struct TraceEvent {
+    // Names are string literals, they are not copied.
+    const char* name;
+    const char* argName;
+    int64_t     arg;
+    // Nanoseconds on the steady clock.
+    int64_t     begin;
+    int64_t     end;
+};
+
+// Records spans of work on a timeline, per thread, for chrome://tracing or
+// Perfetto to show.
+//
+// Each thread appends to its own buffer without taking a lock; the buffers
+// are only read by write(), which has to be called once the traced work is
+// done. Recording is off until start(), and a span costs a flag check then.
+class Tracer {
+   public:
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static void start();
+    static void record(const TraceEvent& event);
+
+    // Stops recording and writes everything recorded as Chrome Trace Event
+    // JSON. Throws std::runtime_error if the file can't be written.
+    static void write(const std::string& path);
+
+   private:
+    inline static std::atomic<bool> _enabled{false};
+};
+
+// Records the lifetime of the span, if the tracer is on when it starts.
+class TraceSpan {
+   public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, int64_t arg = 0)
+        : _name(name),
+          _argName(argName),
+          _arg(arg),
+          _begin(Tracer::enabled() ? Tracer::now() : -1) {}
+
+    ~TraceSpan() {
+        if (_begin >= 0) {
+            Tracer::record({_name, _argName, _arg, _begin, Tracer::now()});
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+   private:
+    const char* _name;
+    const char* _argName;
+    int64_t     _arg;
+    int64_t     _begin;
+};
+
+// Traces from construction to destruction into path, or does nothing if path
+// is empty. Errors writing the trace are reported on stderr.
+class TraceSession {
+   public:
+    explicit TraceSession(std::string path);
+    ~TraceSession();
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+   private:
+    std::string _path;
+};
+
+#endif  // SOLVER_PROFILE_TRACE_HH_
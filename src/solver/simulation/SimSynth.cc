@@ -9,29 +9,19 @@
 #include "../../model/Crafter.hh"
 #include "../../model/Recipe.hh"
 #include "../../model/Synth.hh"
+#include "../profile/Profiler.hh"
 
 State SimSynth::execute(const ActionSequence& individual, const State& startState,
                         bool assumeSuccess, bool verbose, bool debug) {
+    PROFILE_PHASE(PhaseSimSynth);
+
     // Clone startState to keep it immutable.
     State s(startState);
 
-    // Conditions
-    double pGood = s.synth->probabilityOfGood();
-    double pExcellent = s.synth->probabilityOfExcellent();
-    bool   ignoreConditionReq = !s.synth->useConditions;
-
     // Step 1 is always normal
-    double ppGood = 0;
-    double ppExcellent = 0;
-    double ppPoor = 0;
-    double ppNormal = 1 - (ppGood + ppExcellent + ppPoor);
-
-    ConditionModel simCondition{
-        .checkGoodOrExcellent = []() { return true; },
-        .pGoodOrExcellent =
-            [ignoreConditionReq, &ppGood, &ppExcellent]() {
-                return ignoreConditionReq ? 1 : (ppGood + ppExcellent);
-            }};
+    ConditionProbabilities pp{0, 0, 0, 1};
+
+    ConditionModel simCondition = makeConditionModel(s, pp);
 
     // Check for empty individuals
     if (individual.empty()) {
@@ -53,86 +43,15 @@ State SimSynth::execute(const ActionSequence& individual, const State& startStat
     }
 
     for (int i = 0; i < individual.size(); ++i) {
-        std::vector<const Action*> actionsArray;
-
         // Combo actions.
         const Action& thisAction = ALL_ACTIONS[individual[i]];
         if (thisAction.isCombo) {
             for (const auto& comboActionId : thisAction.comboActions) {
-                actionsArray.push_back(&ALL_ACTIONS[comboActionId]);
+                stepAction(s, ALL_ACTIONS[comboActionId], simCondition, pp,
+                           assumeSuccess, verbose, debug);
             }
         } else {
-            actionsArray.push_back(&thisAction);
-        }
-
-        for (const auto& action : actionsArray) {
-            // Always occurs.
-            s._step += 1;
-
-            // Condition calculation.
-            double condQualityIncreaseMultiplier = 1.0;
-            if (!ignoreConditionReq) {
-                condQualityIncreaseMultiplier *=
-                    (ppNormal +
-                     1.5 * ppGood *
-                         std::pow(1 - (ppGood + pGood) / 2, s.synth->maxTrickUses) +
-                     4 * ppExcellent + 0.5 * ppPoor);
-            }
-
-            // Calculate progress, quality, and durability gains and losses
-            // under effects of modifiers.
-            ModifiedState r = s.applyModifiers(*action, simCondition);
-
-            // Calculate final gains and losses.
-            double successProbability = r.successProbability;
-            if (assumeSuccess) {
-                successProbability = 1.0;
-            }
-            double progressGain = r.bProgressGain;
-            if (progressGain > 0) {
-                s._reliability = s._reliability * successProbability;
-            }
-            double qualityGain = condQualityIncreaseMultiplier * r.bQualityGain;
-
-            // Floor gains at final stage before calculating expected value.
-            progressGain = successProbability * std::floor(progressGain);
-            qualityGain = successProbability * std::floor(qualityGain);
-
-            // If a wasted action
-            if ((s._progressState >= s.synth->recipe.difficulty) ||
-                (s._durabilityState <= 0) || (s._cpState < 0)) {
-                s._wastedActions += 1;
-            }
-            // If not a wasted action
-            else {
-                s.updateState(*action, progressGain, qualityGain, r.durabilityCost,
-                              r.cpCost, simCondition, successProbability);
-
-                // Ending condition update
-                if (!ignoreConditionReq) {
-                    ppPoor = ppExcellent;
-                    ppGood = ppGood * ppNormal;
-                    ppExcellent = ppExcellent * ppNormal;
-                    ppNormal = 1 - (ppGood + ppExcellent + ppPoor);
-                }
-            }
-
-            double iqCnt = s._effects.countUps[InnerQuiet].value_or(0.0);
-            if (debug) {
-                printf(
-                    "%2d %30s %5.0f %5.0f %8.1f %8.1f %5.1f %8d %8.1f %5.1f %5.1f "
-                    "%5.1f\n",
-                    s._step, action->fullName, s._durabilityState, s._cpState,
-                    s._qualityState, s._progressState, iqCnt, r.control, qualityGain,
-                    std::floor(r.bProgressGain), std::floor(r.bQualityGain),
-                    s._wastedActions);
-            } else if (verbose) {
-                printf("%2d %30s %5.0f %5.0f %8.1f %8.1f %5.1f\n", s._step,
-                       action->fullName, s._durabilityState, s._cpState, s._qualityState,
-                       s._progressState, iqCnt);
-            }
-
-            s._action = action->id;
+            stepAction(s, thisAction, simCondition, pp, assumeSuccess, verbose, debug);
         }
     }
 
@@ -151,4 +70,108 @@ State SimSynth::execute(const ActionSequence& individual, const State& startStat
     // Return final state
     s._action = individual.back();
     return s;
-}
\ No newline at end of file
+}
+
+void SimSynth::step(State& s, ActionId actionId, bool assumeSuccess) {
+    // The expected condition probabilities never leave their step 1 values
+    // (see the update in stepAction), so a fresh set is equivalent to the one
+    // execute() would be carrying at this point.
+    ConditionProbabilities pp{0, 0, 0, 1};
+
+    ConditionModel simCondition = makeConditionModel(s, pp);
+
+    const Action& thisAction = ALL_ACTIONS[actionId];
+    if (thisAction.isCombo) {
+        for (const auto& comboActionId : thisAction.comboActions) {
+            stepAction(s, ALL_ACTIONS[comboActionId], simCondition, pp, assumeSuccess,
+                       false, false);
+        }
+    } else {
+        stepAction(s, thisAction, simCondition, pp, assumeSuccess, false, false);
+    }
+}
+
+ConditionModel SimSynth::makeConditionModel(const State&                  s,
+                                            const ConditionProbabilities& pp) const {
+    bool ignoreConditionReq = !s.synth->useConditions;
+
+    return {.checkGoodOrExcellent = []() { return true; },
+            .pGoodOrExcellent =
+                [ignoreConditionReq, &pp]() {
+                    return ignoreConditionReq ? 1 : (pp.ppGood + pp.ppExcellent);
+                }};
+}
+
+void SimSynth::stepAction(State& s, const Action& action,
+                          const ConditionModel& simCondition, ConditionProbabilities& pp,
+                          bool assumeSuccess, bool verbose, bool debug) {
+    // Conditions
+    double pGood = s.synth->probabilityOfGood();
+    bool   ignoreConditionReq = !s.synth->useConditions;
+
+    // Always occurs.
+    s._step += 1;
+
+    // Condition calculation.
+    double condQualityIncreaseMultiplier = 1.0;
+    if (!ignoreConditionReq) {
+        condQualityIncreaseMultiplier *=
+            (pp.ppNormal +
+             1.5 * pp.ppGood *
+                 std::pow(1 - (pp.ppGood + pGood) / 2, s.synth->maxTrickUses) +
+             4 * pp.ppExcellent + 0.5 * pp.ppPoor);
+    }
+
+    // Calculate progress, quality, and durability gains and losses
+    // under effects of modifiers.
+    ModifiedState r = s.applyModifiers(action, simCondition);
+
+    // Calculate final gains and losses.
+    double successProbability = r.successProbability;
+    if (assumeSuccess) {
+        successProbability = 1.0;
+    }
+    double progressGain = r.bProgressGain;
+    if (progressGain > 0) {
+        s._reliability = s._reliability * successProbability;
+    }
+    double qualityGain = condQualityIncreaseMultiplier * r.bQualityGain;
+
+    // Floor gains at final stage before calculating expected value.
+    progressGain = successProbability * std::floor(progressGain);
+    qualityGain = successProbability * std::floor(qualityGain);
+
+    // If a wasted action
+    if ((s._progressState >= s.synth->recipe.difficulty) || (s._durabilityState <= 0) ||
+        (s._cpState < 0)) {
+        s._wastedActions += 1;
+    }
+    // If not a wasted action
+    else {
+        s.updateState(action, progressGain, qualityGain, r.durabilityCost, r.cpCost,
+                      simCondition, successProbability);
+
+        // Ending condition update
+        if (!ignoreConditionReq) {
+            pp.ppPoor = pp.ppExcellent;
+            pp.ppGood = pp.ppGood * pp.ppNormal;
+            pp.ppExcellent = pp.ppExcellent * pp.ppNormal;
+            pp.ppNormal = 1 - (pp.ppGood + pp.ppExcellent + pp.ppPoor);
+        }
+    }
+
+    double iqCnt = s._effects.countUps[InnerQuiet].value_or(0.0);
+    if (debug) {
+        printf(
+            "%2d %30s %5.0f %5.0f %8.1f %8.1f %5.1f %8d %8.1f %5.1f %5.1f "
+            "%5.1f\n",
+            s._step, action.fullName, s._durabilityState, s._cpState, s._qualityState,
+            s._progressState, iqCnt, r.control, qualityGain, std::floor(r.bProgressGain),
+            std::floor(r.bQualityGain), s._wastedActions);
+    } else if (verbose) {
+        printf("%2d %30s %5.0f %5.0f %8.1f %8.1f %5.1f\n", s._step, action.fullName,
+               s._durabilityState, s._cpState, s._qualityState, s._progressState, iqCnt);
+    }
+
+    s._action = action.id;
+}
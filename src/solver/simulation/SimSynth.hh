@@ -4,10 +4,33 @@
 #include "../../model/State.hh"
 #include "../Individual.hh"
 
+class Action;
+class ConditionModel;
+
 class SimSynth {
    public:
     State execute(const ActionSequence& individual, const State& startState,
                   bool assumeSuccess, bool verbose, bool debug);
+
+    // Applies a single (possibly combo) action to the state in place,
+    // exactly as execute() would as part of a longer sequence.
+    void step(State& s, ActionId actionId, bool assumeSuccess);
+
+   private:
+    // Expected material condition probabilities, carried from step to step.
+    struct ConditionProbabilities {
+        double ppGood;
+        double ppExcellent;
+        double ppPoor;
+        double ppNormal;
+    };
+
+    ConditionModel makeConditionModel(const State&                  s,
+                                      const ConditionProbabilities& pp) const;
+
+    void stepAction(State& s, const Action& action, const ConditionModel& simCondition,
+                    ConditionProbabilities& pp, bool assumeSuccess, bool verbose,
+                    bool debug);
 };
 
-#endif  // SOLVER_SIMULATION_SIMSYNTH_HH_
\ No newline at end of file
+#endif  // SOLVER_SIMULATION_SIMSYNTH_HH_
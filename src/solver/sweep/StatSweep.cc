@@ -0,0 +1,145 @@
+#include "StatSweep.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "../Solver.hh"
+#include "../SolverSettings.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+
+StatSweep::StatSweep(ThreadPool& pool, const SweepVars& vars)
+    : _pool(pool), _vars(vars), _inner(vars.mode == GridSweep ? 2 : vars.mode - 1) {}
+
+std::vector<SweepPoint> StatSweep::run(const SolverSettings& settings,
+                                       const PointCallback&  onPoint) {
+    const std::array<std::vector<int>, 3> axes = {
+        values(_vars.craftsmanship), values(_vars.control), values(_vars.craftingPoints)};
+
+    std::vector<Chain> chains;
+    int                outer1 = _inner == 0 ? 1 : 0;
+    int                outer2 = _inner == 2 ? 1 : 2;
+    for (int value1 : axes[outer1]) {
+        for (int value2 : axes[outer2]) {
+            Chain& chain = chains.emplace_back();
+            chain.stats[outer1] = value1;
+            chain.stats[outer2] = value2;
+            chain.values = axes[_inner];
+        }
+    }
+
+    std::vector<std::optional<SweepPoint>> least(chains.size());
+    _pool.parallelFor(chains.size(), _vars.maxJobs, [&](int i) {
+        TraceSpan span("sweep chain", "chain", i);
+        least[i] = searchChain(settings, chains[i], onPoint);
+    });
+
+    std::vector<SweepPoint> frontier;
+    for (const auto& point : least) {
+        if (!point) {
+            continue;
+        }
+        bool dominated = std::any_of(least.begin(), least.end(), [&](const auto& other) {
+            return other && other->stats != point->stats &&
+                   other->stats[0] <= point->stats[0] &&
+                   other->stats[1] <= point->stats[1] &&
+                   other->stats[2] <= point->stats[2];
+        });
+        if (!dominated) {
+            frontier.push_back(*point);
+        }
+    }
+    std::sort(frontier.begin(), frontier.end(),
+              [](const SweepPoint& a, const SweepPoint& b) { return a.stats < b.stats; });
+    return frontier;
+}
+
+std::optional<SweepPoint> StatSweep::searchChain(const SolverSettings& settings,
+                                                 const Chain&          chain,
+                                                 const PointCallback&  onPoint) {
+    std::vector<Individual> population;
+    auto                    solve = [&](int index) {
+        std::array<int, 3> stats = chain.stats;
+        stats[_inner] = chain.values[index];
+        SweepPoint point = solvePoint(settings, stats, population);
+
+        std::lock_guard lock(_mutex);
+        if (onPoint) {
+            onPoint(point);
+        }
+        return point;
+    };
+
+    if (_vars.mode == GridSweep) {
+        for (int i = 0; i < chain.values.size(); ++i) {
+            SweepPoint point = solve(i);
+            if (point.sufficient) {
+                return point;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // The highest value goes first: if even that falls short, nothing will.
+    int        low = 0;
+    int        high = chain.values.size() - 1;
+    SweepPoint best = solve(high);
+    if (!best.sufficient) {
+        return std::nullopt;
+    }
+    while (low < high) {
+        int        mid = (low + high) / 2;
+        SweepPoint point = solve(mid);
+        if (point.sufficient) {
+            high = mid;
+            best = std::move(point);
+        } else {
+            low = mid + 1;
+        }
+    }
+    return best;
+}
+
+SweepPoint StatSweep::solvePoint(const SolverSettings&     settings,
+                                 const std::array<int, 3>& stats,
+                                 std::vector<Individual>&  population) {
+    const auto start = std::chrono::steady_clock::now();
+
+    SolverSettings pointSettings(settings);
+    pointSettings.crafter.craftsmanship = stats[0];
+    pointSettings.crafter.control = stats[1];
+    pointSettings.crafter.craftingPoints = stats[2];
+    pointSettings.quiet = true;
+    pointSettings.debug = false;
+    pointSettings.termination.stopAtMaxQuality = true;
+    // Points solve side by side, and must not resume or overwrite each other.
+    pointSettings.checkpoint = {};
+    pointSettings.telemetry = {};
+
+    Solver solver(pointSettings, _pool);
+    solver.setInitialPopulation(std::move(population));
+    solver.solve();
+    population = solver.population();
+
+    return {
+        .stats = stats,
+        .sufficient = solver.reachedMaxQuality(),
+        .best = solver.best(),
+        .seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                       .count(),
+    };
+}
+
+std::vector<int> StatSweep::values(const StatRange& range) {
+    if (range.min > range.max || range.step <= 0) {
+        throw std::invalid_argument("A stat range needs min <= max and a positive step.");
+    }
+
+    std::vector<int> values;
+    for (long value = range.min; value < range.max; value += range.step) {
+        values.push_back(value);
+    }
+    values.push_back(range.max);
+    return values;
+}
@@ -0,0 +1,66 @@
+#ifndef SOLVER_SWEEP_STATSWEEP_HH_
+#define SOLVER_SWEEP_STATSWEEP_HH_
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "../Individual.hh"
+#include "SweepVars.hh"
+
+class SolverSettings;
+class ThreadPool;
+
+struct SweepPoint {
+    // Craftsmanship, control and CP.
+    std::array<int, 3> stats;
+    // Whether the best macro found finishes the craft at max quality.
+    bool               sufficient;
+    Individual         best;
+    double             seconds;
+};
+
+// Finds the least crafter stats that still reach max quality on a recipe.
+//
+// Reaching max quality is taken to be monotone in every stat, so for each pair
+// of the two outer stats only the least sufficient value of the innermost one
+// is looked for. The pairs are solved in parallel; the solves for one pair run
+// one after the other, each starting from the population the previous one
+// ended with, and stop as soon as max quality is reached.
+class StatSweep {
+   public:
+    using PointCallback = std::function<void(const SweepPoint& point)>;
+
+    StatSweep(ThreadPool& pool, const SweepVars& vars);
+
+    // Returns the Pareto frontier of the sufficient points: those for which no
+    // other sufficient point needs as much or less of every stat, ordered by
+    // craftsmanship, control and CP. onPoint, if set, is called with every
+    // point solved, never concurrently.
+    std::vector<SweepPoint> run(const SolverSettings& settings,
+                                const PointCallback&  onPoint);
+
+   private:
+    // One pair of outer stats and the values to try for the inner one.
+    struct Chain {
+        std::array<int, 3> stats;
+        std::vector<int>   values;
+    };
+
+    std::optional<SweepPoint> searchChain(const SolverSettings& settings,
+                                          const Chain&          chain,
+                                          const PointCallback&  onPoint);
+    SweepPoint solvePoint(const SolverSettings& settings, const std::array<int, 3>& stats,
+                          std::vector<Individual>& population);
+
+    static std::vector<int> values(const StatRange& range);
+
+    ThreadPool& _pool;
+    SweepVars   _vars;
+    int         _inner;
+    std::mutex  _mutex;
+};
+
+#endif  // SOLVER_SWEEP_STATSWEEP_HH_
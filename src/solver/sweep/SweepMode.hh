@@ -0,0 +1,13 @@
+#ifndef SOLVER_SWEEP_SWEEPMODE_HH_
+#define SOLVER_SWEEP_SWEEPMODE_HH_
+
+// How a stat sweep finds the least sufficient value of its innermost stat: by
+// trying them in order, or by a binary search on the given stat.
+enum SweepMode {
+    GridSweep = 0,
+    CraftsmanshipSearch,
+    ControlSearch,
+    CraftingPointsSearch,
+};
+
+#endif  // SOLVER_SWEEP_SWEEPMODE_HH_
@@ -0,0 +1,25 @@
+#ifndef SOLVER_SWEEP_SWEEPVARS_HH_
+#define SOLVER_SWEEP_SWEEPVARS_HH_
+
+#include "SweepMode.hh"
+
+// Values from min to max in steps of step; max is always included.
+struct StatRange {
+    int min;
+    int max;
+    int step;
+};
+
+struct SweepVars {
+    StatRange craftsmanship;
+    StatRange control;
+    StatRange craftingPoints;
+    // A grid sweep goes through CP in order for every craftsmanship and control
+    // pair; a search does a binary search on its stat for every pair of the
+    // other two.
+    SweepMode mode;
+    // Stat pairs solved at once, 0 for one per pool thread.
+    int       maxJobs;
+};
+
+#endif  // SOLVER_SWEEP_SWEEPVARS_HH_
@@ -0,0 +1,11 @@
+#ifndef SOLVER_TELEMETRY_TELEMETRYFORMAT_HH_
+#define SOLVER_TELEMETRY_TELEMETRYFORMAT_HH_
+
+enum TelemetryFormat {
+    // A header, then one line per record.
+    TelemetryCsv,
+    // One JSON object per line.
+    TelemetryJsonl,
+};
+
+#endif  // SOLVER_TELEMETRY_TELEMETRYFORMAT_HH_
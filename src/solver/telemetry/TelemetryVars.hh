@@ -0,0 +1,16 @@
+#ifndef SOLVER_TELEMETRY_TELEMETRYVARS_HH_
+#define SOLVER_TELEMETRY_TELEMETRYVARS_HH_
+
+#include <string>
+
+#include "TelemetryFormat.hh"
+
+struct TelemetryVars {
+    // File a record of every interval-th generation is written to. Empty
+    // disables telemetry.
+    std::string     path;
+    TelemetryFormat format;
+    int             interval;
+};
+
+#endif  // SOLVER_TELEMETRY_TELEMETRYVARS_HH_
@@ -0,0 +1,163 @@
+#include "TelemetryWriter.hh"
+
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include "../Diversity.hh"
+
+namespace {
+
+std::string number(double x) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.10g", x);
+    return text;
+}
+
+// The values, with separator between each two.
+template <typename Container>
+std::string join(const Container& values, const char* separator) {
+    std::string text;
+    for (auto x : values) {
+        if (!text.empty()) {
+            text += separator;
+        }
+        text += number(x);
+    }
+    return text;
+}
+
+void measure(GenerationRecord& record) {
+    std::array<double, 2> genotypes = genotypeDiversity(record.population);
+    record.distinctRatio = genotypes[0];
+    record.editDistance = genotypes[1];
+    record.diversity = fitnessDiversity(record.population);
+    record.population = {};
+}
+
+}  // namespace
+
+TelemetryWriter::TelemetryWriter(const std::string& path, TelemetryFormat format,
+                                 bool append)
+    : _path(path),
+      _format(format),
+      _file(path, append ? std::ios::app : std::ios::trunc),
+      _needsHeader(format == TelemetryCsv && !append),
+      _failed(false),
+      _stopping(false) {
+    if (!_file) {
+        throw std::runtime_error("Could not open telemetry file " + path);
+    }
+    _thread = std::thread(&TelemetryWriter::writerLoop, this);
+}
+
+TelemetryWriter::~TelemetryWriter() {
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void TelemetryWriter::write(GenerationRecord record) {
+    {
+        std::lock_guard lock(_mutex);
+        _queue.push_back(std::move(record));
+    }
+    _cv.notify_one();
+}
+
+void TelemetryWriter::writerLoop() {
+    std::vector<GenerationRecord> batch;
+    std::string                   out;
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            _cv.wait(lock, [this] { return _stopping || !_queue.empty(); });
+            if (_queue.empty()) {
+                break;
+            }
+            std::swap(batch, _queue);
+        }
+
+        out.clear();
+        for (GenerationRecord& record : batch) {
+            measure(record);
+            format(record, out);
+        }
+        batch.clear();
+
+        _file.write(out.data(), out.size());
+        if (!_file && !_failed) {
+            fprintf(stderr, "Could not write telemetry to %s\n", _path.c_str());
+            _failed = true;
+        }
+    }
+    _file.flush();
+}
+
+void TelemetryWriter::format(const GenerationRecord& r, std::string& out) {
+    // Both formats have the same names and, in order, the same values.
+    const std::pair<const char*, std::string> scalars[] = {
+        {"generation", std::to_string(r.generation)},
+        {"seconds", number(r.seconds)},
+        {"generationSeconds", number(r.generationSeconds)},
+        {"evaluations", std::to_string(r.evaluations)},
+        {"totalEvaluations", std::to_string(r.totalEvaluations)},
+        {"bestFitness", number(r.best.fitness)},
+        {"bestProgress", number(r.best.fitnessProg)},
+        {"bestCp", number(r.best.cpState)},
+        {"bestLength", std::to_string(r.best.length)},
+        {"duplicates", std::to_string(r.duplicates)},
+        {"distinctRatio", number(r.distinctRatio)},
+        {"editDistance", number(r.editDistance)},
+    };
+    const char*       separator = _format == TelemetryCsv ? "," : ", ";
+    const std::string lists[][2] = {
+        {"diversity", join(r.diversity, separator)},
+        {"lastFitnesses", join(r.lastFitnesses, separator)},
+        {"stagnationCounter", join(r.stagnationCounter, separator)},
+    };
+
+    if (_format == TelemetryJsonl) {
+        std::string line;
+        for (const auto& [name, value] : scalars) {
+            line += line.empty() ? "{\"" : ", \"";
+            line += name + std::string("\": ") + value;
+        }
+        for (const auto& [name, values] : lists) {
+            line += ", \"" + name + "\": [" + values + "]";
+        }
+        out += line + "}\n";
+        return;
+    }
+
+    // The lists take a column per entry, numbered from 1.
+    if (_needsHeader) {
+        std::string header;
+        for (const auto& [name, value] : scalars) {
+            header += header.empty() ? "" : ",";
+            header += name;
+        }
+        const size_t sizes[] = {r.diversity.size(), r.lastFitnesses.size(),
+                                r.stagnationCounter.size()};
+        for (int list = 0; list < std::size(lists); ++list) {
+            for (int i = 1; i <= sizes[list]; ++i) {
+                header += "," + lists[list][0] + std::to_string(i);
+            }
+        }
+        out += header + "\n";
+        _needsHeader = false;
+    }
+    std::string line;
+    for (const auto& [name, value] : scalars) {
+        line += line.empty() ? "" : ",";
+        line += value;
+    }
+    for (const auto& [name, values] : lists) {
+        line += "," + values;
+    }
+    out += line + "\n";
+}
@@ -0,0 +1,73 @@
+#ifndef SOLVER_TELEMETRY_TELEMETRYWRITER_HH_
+#define SOLVER_TELEMETRY_TELEMETRYWRITER_HH_
+
+#include <array>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Individual.hh"
+#include "TelemetryFormat.hh"
+
+// What the genetic engine reports about one generation.
+struct GenerationRecord {
+    int                     generation;
+    // Since the run started, and spent on this generation.
+    double                  seconds;
+    double                  generationSeconds;
+    // Sequences evaluated in this generation, and in the run so far.
+    long                    evaluations;
+    long                    totalEvaluations;
+    Fitness                 best;
+    // Offspring replaced for copying another individual.
+    int                     duplicates;
+    // Per subpopulation.
+    std::vector<double>     lastFitnesses;
+    std::vector<int>        stagnationCounter;
+    // A copy of the population, which the writer measures the rest from.
+    std::vector<Individual> population;
+    // Share of distinct sequences, and mean edit distance of a sample of pairs.
+    double                  distinctRatio;
+    double                  editDistance;
+    // Standard deviations of the population's fitness, progress, CP and length.
+    std::array<double, 4>   diversity;
+};
+
+// Writes generation records to a file from a thread of its own.
+//
+// write() only queues a record, so the genetic engine never waits on measuring
+// the population's diversity, on formatting or on the disk. Records are written
+// in batches, whatever has queued up while the last batch was written, and all
+// of them are written by the time the writer is destroyed.
+class TelemetryWriter {
+   public:
+    // Appending leaves out the CSV header. Throws std::runtime_error if the file
+    // can't be opened.
+    TelemetryWriter(const std::string& path, TelemetryFormat format, bool append);
+    ~TelemetryWriter();
+
+    TelemetryWriter(const TelemetryWriter&) = delete;
+    TelemetryWriter& operator=(const TelemetryWriter&) = delete;
+
+    void write(GenerationRecord record);
+
+   private:
+    void writerLoop();
+    void format(const GenerationRecord& record, std::string& out);
+
+    std::string                   _path;
+    TelemetryFormat               _format;
+    std::ofstream                 _file;
+    bool                          _needsHeader;
+    bool                          _failed;
+    std::vector<GenerationRecord> _queue;
+    std::mutex                    _mutex;
+    std::condition_variable       _cv;
+    bool                          _stopping;
+    std::thread                   _thread;
+};
+
+#endif  // SOLVER_TELEMETRY_TELEMETRYWRITER_HH_
@@ -0,0 +1,88 @@
+#include "MacroValidator.hh"
+
+#include <algorithm>
+
+#include "../montecarlo/MonteCarloSim.hh"
+#include "../parallel/ThreadPool.hh"
+#include "../profile/Trace.hh"
+#include "../simulation/SimSynth.hh"
+
+namespace {
+
+// Macros per pool task: enough to pay for the task and the simulators it sets
+// up, few enough to balance the load.
+constexpr int CHUNK_SIZE = 16;
+
+}  // namespace
+
+MacroValidator::MacroValidator(ThreadPool& pool, const SolverSettings& settings,
+                               std::vector<Crafter> crafters, const ValidationVars& vars)
+    : _pool(pool), _settings(settings), _vars(vars), _crafters(std::move(crafters)) {
+    // States point at their synth and synths at their crafter, so neither list
+    // may move once filled.
+    _synths.reserve(_crafters.size());
+    _startStates.reserve(_crafters.size());
+    for (const Crafter& crafter : _crafters) {
+        const Synth& synth = _synths.emplace_back(
+            crafter, _settings.recipe, _settings.maxTrickUses,
+            _settings.reliabilityPercent / 100.0, _settings.useConditions,
+            _settings.maxLength, _settings.solver);
+        _startStates.emplace_back(synth);
+
+        std::bitset<ACTION_COUNT>& available = _available.emplace_back();
+        for (ActionId actionId : crafter.actions) {
+            available.set(actionId);
+        }
+    }
+}
+
+std::vector<MacroCheck> MacroValidator::validate(
+    const std::vector<ActionSequence>& macros) {
+    const int               nCrafters = _crafters.size();
+    std::vector<MacroCheck> checks(macros.size() * nCrafters);
+
+    const int nChunks = (macros.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _pool.parallelFor(nChunks, _vars.threads, [&](int chunk) {
+        TraceSpan     span("validation batch", "chunk", chunk);
+        SimSynth      simSynth;
+        MonteCarloSim monteCarloSim;
+
+        const int end = std::min<int>(macros.size(), (chunk + 1) * CHUNK_SIZE);
+        for (int m = chunk * CHUNK_SIZE; m < end; ++m) {
+            const ActionSequence& macro = macros[m];
+
+            std::bitset<ACTION_COUNT> used;
+            for (ActionId actionId : macro) {
+                used.set(actionId);
+            }
+
+            // Seeded per macro, so that results don't depend on the chunking.
+            monteCarloSim.seed(_vars.seed + m);
+            for (int c = 0; c < nCrafters; ++c) {
+                MacroCheck& check = checks[m * nCrafters + c];
+                if ((used & ~_available[c]).any()) {
+                    check = {.feasible = false, .quality = 0, .successPercent = 0};
+                    continue;
+                }
+
+                State result =
+                    simSynth.execute(macro, _startStates[c], false, false, false);
+
+                bool progressOk, cpOk, durabilityOk, trickOk, reliabilityOk;
+                result.checkViolations(progressOk, cpOk, durabilityOk, trickOk,
+                                       reliabilityOk);
+
+                check.feasible = progressOk && cpOk && durabilityOk;
+                check.quality = result.quality();
+                check.successPercent = 0;
+                if (_vars.monteCarloRuns > 0) {
+                    int successes = monteCarloSim.successes(
+                        macro, _startStates[c], _vars.monteCarloRuns, SkipUnusable);
+                    check.successPercent = 100.0 * successes / _vars.monteCarloRuns;
+                }
+            }
+        }
+    });
+
+    return checks;
+}
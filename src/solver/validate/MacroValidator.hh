@@ -0,0 +1,57 @@
+#ifndef SOLVER_VALIDATE_MACROVALIDATOR_HH_
+#define SOLVER_VALIDATE_MACROVALIDATOR_HH_
+
+#include <bitset>
+#include <vector>
+
+#include "../../actions/ActionId.hh"
+#include "../../model/Crafter.hh"
+#include "../../model/State.hh"
+#include "../../model/Synth.hh"
+#include "../Individual.hh"
+#include "../SolverSettings.hh"
+#include "ValidationVars.hh"
+
+class ThreadPool;
+
+struct MacroCheck {
+    // Finishes the craft within CP and durability when simulated with expected
+    // values, and uses only actions the crafter has.
+    bool   feasible;
+    // Quality at the end of that simulation.
+    double quality;
+    // Share of the Monte Carlo runs that finish the craft.
+    double successPercent;
+};
+
+// Checks a library of macros against many crafters at once.
+//
+// Everything that only depends on a crafter, its synth, start state and
+// actions, is set up once and shared by all macros. Each macro is then played
+// for every crafter in turn, and the macros are spread over the pool.
+class MacroValidator {
+   public:
+    // The recipe and the rules of the craft come from settings, the crafter from
+    // each of crafters in turn.
+    MacroValidator(ThreadPool& pool, const SolverSettings& settings,
+                   std::vector<Crafter> crafters, const ValidationVars& vars);
+
+    MacroValidator(const MacroValidator&) = delete;
+    MacroValidator& operator=(const MacroValidator&) = delete;
+
+    // One check per macro and crafter, those of a macro next to each other: the
+    // check of macro m for crafter c is at m * crafters + c.
+    std::vector<MacroCheck> validate(const std::vector<ActionSequence>& macros);
+
+   private:
+    ThreadPool&    _pool;
+    SolverSettings _settings;
+    ValidationVars _vars;
+
+    std::vector<Crafter>                   _crafters;
+    std::vector<Synth>                     _synths;
+    std::vector<State>                     _startStates;
+    std::vector<std::bitset<ACTION_COUNT>> _available;
+};
+
+#endif  // SOLVER_VALIDATE_MACROVALIDATOR_HH_
@@ -0,0 +1,13 @@
+#ifndef SOLVER_VALIDATE_VALIDATIONVARS_HH_
+#define SOLVER_VALIDATE_VALIDATIONVARS_HH_
+
+struct ValidationVars {
+    // Monte Carlo runs per macro and crafter. 0 skips the success rate.
+    int      monteCarloRuns;
+    // Seed of the Monte Carlo runs, so that results can be reproduced.
+    unsigned seed;
+    // Most pool threads to use. 0 uses all of them.
+    int      threads;
+};
+
+#endif  // SOLVER_VALIDATE_VALIDATIONVARS_HH_